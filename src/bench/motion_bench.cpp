@@ -0,0 +1,234 @@
+/**
+ * @file motion_bench.cpp
+ * @brief Step timing benchmark for the motion engine
+ * 
+ * Replaces main.cpp in the esp32dev_motion_bench environment:
+ * 
+ *   pio run -e esp32dev_motion_bench -t upload -t monitor
+ * 
+ * Runs a fixed set of move profiles on the stepper pins with a StepTrace
+ * attached and prints, per profile:
+ *  - jitter percentiles (actual minus commanded step interval, in us)
+ *  - achieved vs commanded step rate
+ *  - CPU share of each core while the move ran
+ * 
+ * The same profiles then run on a StaticStepper with the same wiring. It has
+ * no trace hook, so only the move time against the commanded time and the
+ * CPU share are reported, for comparison with the Stepper rows.
+ * 
+ * CPU share is measured with a spin counter task per core at idle priority:
+ * it is calibrated on a quiet system first, and any time it loses during a
+ * move went to the motion path (step task, esp_timer task or ISR). Run the
+ * bench without a motor load; only the coil GPIOs are toggled.
+ */
+
+#ifdef MOTION_BENCH
+
+#include <Arduino.h>
+#include <algorithm>
+#include <defines.hpp>
+#include "stepper/Stepper.h"
+#include "stepper/StaticStepper.h"
+#include "stepper/StepTrace.h"
+
+// Length of the quiet calibration window in ms
+#define BENCH_CALIBRATION_MS 1000
+
+/**
+ * @brief One benchmark case
+ */
+struct BenchProfile {
+    const char* name;
+    bool async;                 // moveAsync() instead of blocking step()
+    long rpm;
+    StepRamp::Profile profile;
+    long acceleration;          // steps/s^2, ignored for CONSTANT
+    int steps;
+};
+
+static const BenchProfile profiles[] = {
+    {"step 30rpm const",      false, 30,  StepRamp::CONSTANT,  0,    400},
+    {"step 120rpm const",     false, 120, StepRamp::CONSTANT,  0,    1000},
+    {"step 300rpm trapezoid", false, 300, StepRamp::TRAPEZOID, 2000, 1000},
+    {"async 120rpm const",    true,  120, StepRamp::CONSTANT,  0,    1000},
+    {"async 300rpm trapezoid",true,  300, StepRamp::TRAPEZOID, 2000, 1000},
+    {"async 600rpm s-curve",  true,  600, StepRamp::S_CURVE,   4000, 1000},
+};
+
+static Stepper stepper(MOTOR_STEPS, MOTOR_PIN_1, MOTOR_PIN_2, MOTOR_PIN_3, MOTOR_PIN_4);
+static StaticStepper<Stepper::FULL_STEP, MOTOR_PIN_1, MOTOR_PIN_2, MOTOR_PIN_3, MOTOR_PIN_4> staticStepper(MOTOR_STEPS);
+static StepRamp commandedRamp;
+static StepTrace trace;
+static int32_t jitter[STEPPER_TRACE_SIZE];
+
+static volatile uint32_t spinCount[2];
+static float spinRate[2];   // spins per us on a quiet core
+
+/**
+ * @brief Idle-priority spinner, its count drops while other work runs
+ */
+static void spinTask(void* param) {
+    volatile uint32_t* counter = static_cast<volatile uint32_t*>(param);
+    for (;;) {
+        (*counter)++;
+    }
+}
+
+static void resetSpin() {
+    spinCount[0] = 0;
+    spinCount[1] = 0;
+}
+
+/**
+ * @brief Busy share of a core in percent over elapsedUs
+ */
+static float cpuShare(int core, int64_t elapsedUs) {
+    const float expected = spinRate[core] * (float)elapsedUs;
+    if (expected <= 0) {
+        return 0;
+    }
+    const float share = 100.0f * (1.0f - (float)spinCount[core] / expected);
+    return share < 0 ? 0 : share;
+}
+
+static int32_t percentile(int n, int pct) {
+    int index = (n - 1) * pct / 100;
+    return jitter[index];
+}
+
+static void runProfile(const BenchProfile& p) {
+    stepper.setSpeed(p.rpm);
+    stepper.setAcceleration(p.acceleration);
+    stepper.setProfile(p.profile);
+
+    trace.clear();
+    stepper.setTrace(&trace);
+    resetSpin();
+    const int64_t start = esp_timer_get_time();
+
+    if (p.async) {
+        stepper.moveAsync(p.steps);
+        while (stepper.isRunning()) {
+            vTaskDelay(1);
+        }
+    } else {
+        stepper.step(p.steps);
+    }
+
+    const int64_t elapsed = esp_timer_get_time() - start;
+    stepper.setTrace(NULL);
+
+    // Interval error of every step that has a predecessor in the move
+    int n = 0;
+    uint64_t actualTotal = 0;
+    uint64_t commandedTotal = 0;
+    for (int i = 1; i < trace.size(); i++) {
+        const StepTrace::Sample& sample = trace.at(i);
+        if (sample.commanded == 0) {
+            continue;
+        }
+        const uint32_t actual = sample.time - trace.at(i - 1).time;
+        jitter[n++] = (int32_t)actual - (int32_t)sample.commanded;
+        actualTotal += actual;
+        commandedTotal += sample.commanded;
+    }
+
+    if (n == 0 || actualTotal == 0) {
+        Serial.printf("[Bench] %-24s no samples\n", p.name);
+        return;
+    }
+    std::sort(jitter, jitter + n);
+
+    const float achieved = 1e6f * n / (float)actualTotal;
+    const float commanded = 1e6f * n / (float)commandedTotal;
+
+    Serial.printf("[Bench] %-24s %5d %6d %6d %6d %6d %6d %8.1f %8.1f %5.1f%% %5.1f%% %5.1f%%\n",
+                  p.name, n,
+                  (int)jitter[0], (int)percentile(n, 50), (int)percentile(n, 90),
+                  (int)percentile(n, 99), (int)jitter[n - 1],
+                  achieved, commanded, 100.0f * achieved / commanded,
+                  cpuShare(0, elapsed), cpuShare(1, elapsed));
+}
+
+/**
+ * @brief Commanded duration of a move in us, from its first to its last step
+ */
+static uint64_t commandedTime(const BenchProfile& p) {
+    commandedRamp.configure(p.profile, 60L * 1000L * 1000L / MOTOR_STEPS / p.rpm, p.acceleration);
+    uint64_t total = 0;
+    for (int i = 1; i < p.steps; i++) {
+        total += commandedRamp.interval(i, p.steps - 1 - i);
+    }
+    return total;
+}
+
+static void runStaticProfile(const BenchProfile& p) {
+    staticStepper.setSpeed(p.rpm);
+    staticStepper.setAcceleration(p.acceleration);
+    staticStepper.setProfile(p.profile);
+
+    resetSpin();
+    const int64_t start = esp_timer_get_time();
+
+    if (p.async) {
+        staticStepper.moveAsync(p.steps);
+        while (staticStepper.isRunning()) {
+            vTaskDelay(1);
+        }
+    } else {
+        staticStepper.step(p.steps);
+    }
+
+    const int64_t elapsed = esp_timer_get_time() - start;
+    const uint64_t commanded = commandedTime(p);
+
+    Serial.printf("[Bench] %-24s %5d %10lld %10llu %5.1f%% %5.1f%% %5.1f%%\n",
+                  p.name, p.steps, (long long)elapsed, (unsigned long long)commanded,
+                  100.0f * (float)commanded / (float)elapsed,
+                  cpuShare(0, elapsed), cpuShare(1, elapsed));
+}
+
+void setup() {
+    Serial.begin(115200);
+    Serial.println("\n[Bench] Motion benchmark starting...");
+
+    xTaskCreatePinnedToCore(spinTask, "spin0", 1024, (void*)&spinCount[0], tskIDLE_PRIORITY, NULL, 0);
+    xTaskCreatePinnedToCore(spinTask, "spin1", 1024, (void*)&spinCount[1], tskIDLE_PRIORITY, NULL, 1);
+
+    // Calibrate the spinners on a quiet system
+    resetSpin();
+    const int64_t start = esp_timer_get_time();
+    vTaskDelay(pdMS_TO_TICKS(BENCH_CALIBRATION_MS));
+    const int64_t elapsed = esp_timer_get_time() - start;
+    spinRate[0] = (float)spinCount[0] / (float)elapsed;
+    spinRate[1] = (float)spinCount[1] / (float)elapsed;
+
+    Serial.println("[Bench] jitter = actual - commanded interval (us), rate in steps/s, cpu per core");
+    Serial.printf("[Bench] %-24s %5s %6s %6s %6s %6s %6s %8s %8s %6s %6s %6s\n",
+                  "profile", "n", "min", "p50", "p90", "p99", "max",
+                  "rate", "cmd", "ratio", "cpu0", "cpu1");
+
+    for (const BenchProfile& p : profiles) {
+        runProfile(p);
+        vTaskDelay(pdMS_TO_TICKS(200));
+    }
+    stepper.release();
+
+    Serial.println("[Bench] StaticStepper: move time and commanded time in us, cpu per core");
+    Serial.printf("[Bench] %-24s %5s %10s %10s %6s %6s %6s\n",
+                  "profile", "n", "time", "cmd", "ratio", "cpu0", "cpu1");
+
+    for (const BenchProfile& p : profiles) {
+        runStaticProfile(p);
+        vTaskDelay(pdMS_TO_TICKS(200));
+    }
+    staticStepper.release();
+
+    Serial.println("[Bench] Done");
+}
+
+void loop() {
+    vTaskDelay(pdMS_TO_TICKS(1000));
+}
+
+#endif
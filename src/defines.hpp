@@ -1,7 +1,13 @@
 #pragma once
 #include <cstdint>
 
-#define MAX_SLAVES 10
+/**
+ * @brief Capacity of the slave registry, slaves get bus addresses 0..MAX_SLAVES-1
+ * 
+ * Must stay below BUS_ADDR_UNASSIGNED (0xFD). Each slave costs 9 bytes plus
+ * two bytes of hash index.
+ */
+#define MAX_SLAVES 64
 
 /**
  * @file defines.hpp
@@ -63,6 +69,247 @@
 #define TX_PIN 17
 #define RX_PIN 16
 
+/**
+ * @brief Inter-MedBox bus frames
+ * 
+ * Frames carry a type, destination address, sequence number, up to
+ * BUS_MAX_PAYLOAD payload bytes and a CRC16, COBS encoded and delimited by
+ * 0x00. Slaves get addresses 0..MAX_SLAVES-1 during enumeration.
+ * 
+ * dst is a slave address, BUS_ADDR_MASTER or BUS_ADDR_BROADCAST. With
+ * BUS_FRAME_MULTICAST set in the type, dst is a mask of up to eight slave
+ * groups instead, and every slave in one of them takes the frame.
+ */
+#define BUS_MAX_PAYLOAD 64
+#define BUS_MAX_RAW (3 + BUS_MAX_PAYLOAD + 2)
+#define BUS_MAX_ENCODED (BUS_MAX_RAW + BUS_MAX_RAW / 254 + 2)
+#define BUS_ADDR_UNASSIGNED 0xFD
+#define BUS_ADDR_MASTER 0xFE
+#define BUS_ADDR_BROADCAST 0xFF
+#define BUS_FRAME_MULTICAST 0x80
+
+/**
+ * @brief Bus receive task
+ * 
+ * Frames are decoded by a task blocking on the UART driver event queue.
+ * It runs on BUS_RX_TASK_CORE above loop() priority so a frame is handled
+ * as soon as its delimiter arrives.
+ */
+#define BUS_RX_BUFFER_SIZE 1024
+#define BUS_EVENT_QUEUE_SIZE 20
+#define BUS_RX_TASK_CORE 1
+#define BUS_RX_TASK_PRIORITY 3
+
+/**
+ * @brief Enumeration timing
+ * 
+ * BUS_CHAIN_PULSE_US is the SERIAL_OUT pulse that hands enumeration to the
+ * next slave. BUS_TURNAROUND_US bounds the time a node needs to react to a
+ * frame or pulse (ISR, task switch, encoding) on top of pure wire time.
+ */
+#define BUS_CHAIN_PULSE_US 20
+#define BUS_TURNAROUND_US 1500
+
+/**
+ * @brief Enumeration rate
+ * 
+ * ENUM_START and ENUM_FROM go out at BUS_BASE_BAUD and name BUS_ENUM_BAUD,
+ * at which the chain is then walked. Per slave that is the 18-byte ACK and
+ * the 14-byte reply on the wire (0.69 ms at 460800 baud, 2.8 ms at 115200)
+ * plus the reaction time of both ends, about 1 ms in total. Estimated
+ * bound, to be checked against the time enumerateFrom() logs: 64 slaves in
+ * about 65 ms, plus about 8 ms for the rate reset, start turnaround and the
+ * final timeout. Corrupt frames during the walk make the master repeat it
+ * at BUS_BASE_BAUD until the next negotiation succeeds.
+ */
+#define BUS_ENUM_BAUD 460800
+
+/**
+ * @brief SERIAL_IN edge capture and pulse tokens
+ * 
+ * SERIAL_EDGE_QUEUE_SIZE edges (power of two) are buffered between loop()
+ * passes. A LOW pulse of (n + 1) * SERIAL_TOKEN_UNIT_US is token n;
+ * pulses below SERIAL_TOKEN_MIN_US are glitches.
+ */
+#define SERIAL_EDGE_QUEUE_SIZE 64
+#define SERIAL_TOKEN_UNIT_US BUS_CHAIN_PULSE_US
+#define SERIAL_TOKEN_MIN_US 5
+
+/**
+ * @brief An enumerated slave whose SERIAL_IN stays LOW (upstream box
+ * unplugged) for SERIAL_UNPLUG_TIMEOUT ms reports a topology change.
+ */
+#define SERIAL_UNPLUG_TIMEOUT 200
+
+/**
+ * @brief Bus baud rate negotiation
+ * 
+ * The bus starts at BUS_BASE_BAUD. After enumeration the master probes
+ * BUS_BAUD_RATES in ascending order with BUS_BAUD_TEST_FRAMES test frames
+ * and keeps the fastest rate every slave received completely. Slaves go
+ * back to the previous rate if a probe is not committed within
+ * BUS_BAUD_PROBE_TIMEOUT ms.
+ * 
+ * The master falls back to BUS_BASE_BAUD and renegotiates below the
+ * failing rate when more than BUS_MAX_ERROR_PERCENT of the frames received
+ * within BUS_ERROR_CHECK_INTERVAL ms are corrupt.
+ */
+#define BUS_BASE_BAUD 115200
+#define BUS_BAUD_RATES {115200, 230400, 460800, 921600, 1500000, 2000000}
+#define BUS_BAUD_TEST_FRAMES 16
+#define BUS_BAUD_TEST_SIZE 32
+#define BUS_BAUD_PROBE_TIMEOUT 300
+#define BUS_REPLY_TIMEOUT 50
+#define BUS_ERROR_CHECK_INTERVAL 2000
+#define BUS_MAX_ERROR_PERCENT 5
+
+/**
+ * @brief Windowed delivery to slaves
+ * 
+ * Up to BUS_SEND_WINDOW unacknowledged frames per slave (power of two,
+ * at most 32), BUS_SEND_SLOTS frames queued in total. Unacknowledged frames
+ * are resent every BUS_RETRANSMIT_TIMEOUT ms, BUS_MAX_RETRIES times.
+ */
+#define BUS_SEND_WINDOW 8
+#define BUS_SEND_SLOTS 32
+#define BUS_RETRANSMIT_TIMEOUT 20
+#define BUS_MAX_RETRIES 5
+
+/**
+ * @brief Boot-time check of the saved slave list
+ * 
+ * The saved list only speeds up a reboot of the master alone: slaves that
+ * power up with it are unassigned and get enumerated anyway. While a boot
+ * check finds fewer slaves than saved, the master repeats it every
+ * BUS_BOOT_CHECK_INTERVAL ms, BUS_BOOT_CHECKS times in total, and keeps the
+ * saved list so slaves that boot late do not erase it.
+ */
+#define BUS_BOOT_CHECKS 5
+#define BUS_BOOT_CHECK_INTERVAL 1000
+
+/**
+ * @brief PARALLEL_PIN barrier
+ * 
+ * Nodes give up an armed barrier after BUS_BARRIER_TIMEOUT ms. The signal
+ * task running barrier callbacks has BUS_SIGNAL_TASK_PRIORITY, above the
+ * receive task.
+ */
+#define BUS_BARRIER_TIMEOUT 5000
+#define BUS_SIGNAL_TASK_PRIORITY 4
+
+/**
+ * @brief Slave status sweep
+ * 
+ * Slaves answer a broadcast status query in address order, each in its own
+ * slot: the wire time of a BUS_STATUS_SIZE byte report plus
+ * BUS_STATUS_GUARD_US for differences in reaction time. The master sweeps
+ * every BUS_STATUS_INTERVAL ms while the WebSocket is connected.
+ */
+#define BUS_STATUS_SIZE 8
+#define BUS_STATUS_GUARD_US 100
+#define BUS_STATUS_INTERVAL 10000
+
+/**
+ * @brief Stepper motor coil pins and steps per revolution
+ * 
+ * Default wiring of a four-wire stepper. Additional motors pass their own
+ * pins to the Motor constructor.
+ */
+#define MOTOR_PIN_1 32
+#define MOTOR_PIN_2 33
+#define MOTOR_PIN_3 25
+#define MOTOR_PIN_4 26
+#define MOTOR_STEPS 200
+
+// GPIO 6-11 are wired to the SPI flash on ESP32 modules
+#define GPIO_IS_FLASH_PIN(pin) ((pin) >= 6 && (pin) <= 11)
+static_assert(!GPIO_IS_FLASH_PIN(MOTOR_PIN_1) && !GPIO_IS_FLASH_PIN(MOTOR_PIN_2) &&
+              !GPIO_IS_FLASH_PIN(MOTOR_PIN_3) && !GPIO_IS_FLASH_PIN(MOTOR_PIN_4),
+              "motor coil pins must not use the SPI flash GPIOs 6-11");
+
+/**
+ * @brief Coil power between moves
+ * 
+ * Coils keep full power for MOTOR_IDLE_TIMEOUT ms after a move, then drop
+ * to MOTOR_HOLD_DUTY (0-255 PWM duty on the coil driver enable pin,
+ * 0 = release). MOTOR_COIL_ENABLE_PIN is -1 when the enable input is not
+ * wired; reduced hold needs one LEDC channel per motor starting at
+ * MOTOR_HOLD_LEDC_CHANNEL.
+ */
+#define MOTOR_COIL_ENABLE_PIN -1
+#define MOTOR_IDLE_TIMEOUT 500
+#define MOTOR_HOLD_DUTY 0
+#define MOTOR_HOLD_LEDC_CHANNEL 0
+#define MOTOR_HOLD_PWM_FREQ 20000
+
+/**
+ * @brief STEP/DIR driver pins and microstep factor
+ * 
+ * Used by StepDirMotor on boards with STEP/DIR driver chips.
+ * MOTOR_ENABLE_PIN is active LOW; set it to -1 if not connected.
+ */
+#define MOTOR_STEP_PIN 27
+#define MOTOR_DIR_PIN 14
+#define MOTOR_ENABLE_PIN 4
+#define MOTOR_MICROSTEPS 16
+
+/**
+ * @brief Carousel homing and compartment layout
+ * 
+ * HOME_PIN reads the home sensor (active LOW, external pull-up).
+ * COMPARTMENT_COUNT compartments are spread evenly around the carousel
+ * unless configured with Motor::setCompartmentAngle().
+ * MOTOR_HOME_TIMEOUT bounds the homing search in milliseconds.
+ */
+#define HOME_PIN 34
+#define COMPARTMENT_COUNT 8
+#define MOTOR_HOME_TIMEOUT 10000
+
+/**
+ * @brief Dispense planning
+ * 
+ * DISPENSE_STEPS_PER_PILL is the expected carousel rotation per pill.
+ * Batches with up to PLANNER_EXACT_LIMIT distinct compartments are
+ * ordered exactly, larger ones heuristically. As long as COMPARTMENT_COUNT
+ * does not exceed it, every batch is solved exactly unless
+ * DispensePlanner::setExactLimit() lowers the limit.
+ */
+#define DISPENSE_STEPS_PER_PILL 25
+#define PLANNER_EXACT_LIMIT 8
+
+/**
+ * @brief Pill-drop sensor
+ * 
+ * PILL_SENSOR_PIN goes LOW when a pill passes (input-only pin).
+ * A dispense move is bounded by DISPENSE_OVERRUN_FACTOR times the expected
+ * rotation; detections closer than DISPENSE_MIN_PILL_SPACING steps are
+ * treated as sensor bounce.
+ * 
+ * The pill sensor interrupt counts the pill and stops the move itself.
+ * The home sensor interrupt wakes a per-motor event task, which reads the
+ * position and stops the move; it runs at MOTOR_EVENT_TASK_PRIORITY, above
+ * the motion task.
+ */
+#define PILL_SENSOR_PIN 35
+#define DISPENSE_OVERRUN_FACTOR 2
+#define DISPENSE_MIN_PILL_SPACING 4
+#define MOTOR_EVENT_TASK_PRIORITY 6
+
+/**
+ * @brief Motion task configuration
+ * 
+ * MOTION_QUEUE_SIZE segments can be queued ahead (power of two).
+ * The motion task runs on MOTION_TASK_CORE, away from loop() on core 1;
+ * it shares core 0 with the WiFi/lwIP tasks, which run above it.
+ * MOTION_DEFAULT_ACCELERATION is used for ramped segments, in steps/s^2.
+ * A segment that has not finished after MOTION_SEGMENT_TIMEOUT ms is
+ * stopped and reported as not completed.
+ */
+#define MOTION_QUEUE_SIZE 16
+#define MOTION_TASK_CORE 0
+#define MOTION_DEFAULT_ACCELERATION 2000
+#define MOTION_SEGMENT_TIMEOUT 30000
+
 // ============================================================================
 // WebSocket Configuration
 // ============================================================================
@@ -13,6 +13,9 @@ void initializeGPIO() {
     pinMode(SERIAL_OUT_PIN, OUTPUT);
     // pinMode(PARALLEL_PIN, OUTPUT);
     pinMode(PARALLEL_PIN, INPUT); // Drive as open-collector by default
+
+    // Carousel home sensor (input-only pin, external pull-up)
+    pinMode(HOME_PIN, INPUT);
     
     // Initialize output pins to known states
     digitalWrite(SERIAL_OUT_PIN, HIGH);
@@ -12,6 +12,9 @@
 #include "network/wifi_helper.hpp"
 #include "network/websocket_helper.hpp"
 #include "network/communication_helper.hpp"
+#include "motor/steppermotor.hpp"
+#include "motor/motion_task.hpp"
+#include "motor/pill_sensor.hpp"
 
 // Global state
 bool wifi_connected = false;
@@ -21,6 +24,11 @@ WifiHelper wifiHelper;
 WebSocketHelper wsHelper;
 CommunicationHelper commHelper;
 
+// Dispensing motor and the task that runs queued moves on it
+StepperMotor motor;
+GpioPillSensor pillSensor(PILL_SENSOR_PIN);
+MotionTask motionTask;
+
 /**
  * @brief Global LED state pattern (16-bit rotating pattern)
  * 
@@ -78,6 +86,18 @@ void setup() {
 
   // Initialize communication helper (UART, Serial, Parallel pins)
   commHelper.begin(master);
+
+  // Bus ready from the saved slave list, before WiFi and WebSocket
+  if (master) {
+    commHelper.restoreTopology();
+  }
+
+  // Start the motion task; moves queued on it from loop() run back to back.
+  // No WebSocket or UART command queues moves yet, the status report below
+  // only reads whether it is idle
+  motor.initialize();
+  motor.setPillSensor(&pillSensor);
+  motionTask.begin(&motor);
   
   // Attempt WiFi connection (or start BLE config if needed)
   wifi_connected = true;
@@ -101,6 +121,16 @@ void setup() {
       Serial.println(data);
     });
 
+    // Answer the master's status sweep: motion state, compartment, pills
+    commHelper.setStatusProvider([](uint8_t* status) -> uint8_t {
+      const uint16_t pills = motor.getDispensedCount();
+      status[0] = motionTask.isIdle() ? 0 : 1;
+      status[1] = (uint8_t)motor.currentCompartment();
+      status[2] = pills & 0xFF;
+      status[3] = pills >> 8;
+      return 4;
+    });
+
     ledState = 0x0000; // Indicate slave mode with LED pattern
   }
   
@@ -120,12 +150,17 @@ void loop() {
       wsHelper.loop();
 
       if (wsHelper.shouldEnumerate()) {
-        Serial.println("[Loop] WebSocket connected, starting enumeration");
-        commHelper.beginUartEnumeration();
+        // Full enumeration only when the chain changed since the last one
+        Serial.println("[Loop] WebSocket connected, checking slave chain");
+        commHelper.refreshTopology();
       }
 
-      // send periodic heartbeat or status if needed
-      //commHelper.sendUart("Heartbeat from MASTER\n");
+      // Periodic status of all slaves for the backend
+      static unsigned long lastStatusSweep = 0;
+      if (wsHelper.isConnected() && millis() - lastStatusSweep >= BUS_STATUS_INTERVAL) {
+        lastStatusSweep = millis();
+        commHelper.sweepStatus();
+      }
       
       // Monitor WiFi connection status
       if (WiFi.status() != WL_CONNECTED) {
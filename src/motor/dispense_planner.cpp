@@ -0,0 +1,187 @@
+#include "dispense_planner.hpp"
+#include <climits>
+
+DispensePlanner::DispensePlanner(Motor& motor)
+    : motor(motor),
+      stepsPerPill(DISPENSE_STEPS_PER_PILL),
+      totalTravel(0),
+      exactLimit(PLANNER_EXACT_LIMIT),
+      stopTotal(0) {
+}
+
+size_t DispensePlanner::plan(const DispenseRequest* batch, size_t batchSize, DispenseStop* stops) {
+    // Merge requests per compartment
+    stopTotal = 0;
+    for (size_t i = 0; i < batchSize; i++) {
+        if (batch[i].compartment >= COMPARTMENT_COUNT || batch[i].count == 0) {
+            continue;
+        }
+        size_t j = 0;
+        while (j < stopTotal && stopCompartment[j] != batch[i].compartment) {
+            j++;
+        }
+        if (j == stopTotal) {
+            stopCompartment[stopTotal] = batch[i].compartment;
+            stopCount[stopTotal] = 0;
+            stopTotal++;
+        }
+        stopCount[j] += batch[i].count;
+    }
+
+    // Plan with the rotation per pill observed so far
+    stepsPerPill = motor.getStepsPerPill();
+    const long startPosition = motor.getPosition();
+    uint8_t order[COMPARTMENT_COUNT];
+    if (stopTotal <= exactLimit) {
+        solveExact(startPosition, order);
+    } else {
+        solveHeuristic(startPosition, order);
+    }
+
+    // Emit stops with the signed seek move from wherever the previous one ended
+    long position = startPosition;
+    totalTravel = 0;
+    for (size_t i = 0; i < stopTotal; i++) {
+        const uint8_t stop = order[i];
+        stops[i].compartment = stopCompartment[stop];
+        stops[i].count = stopCount[stop];
+        stops[i].travel = motor.shortestMove(position, stopCompartment[stop]);
+        totalTravel += abs(stops[i].travel);
+        position += stops[i].travel + stopCount[stop] * stepsPerPill;
+    }
+
+    Serial.printf("[Planner] %u stops, %ld steps of seek travel\n", (unsigned)stopTotal, totalTravel);
+    return stopTotal;
+}
+
+bool DispensePlanner::enqueue(MotionTask& task, const DispenseStop* stops, size_t stopCount, uint16_t orderId) {
+    // Half a plan would dispense some compartments and silently drop the rest
+    if (task.freeSlots() < 2 * stopCount) {
+        Serial.printf("[Planner] Motion queue has room for %u segments, plan needs %u\n",
+                      (unsigned)task.freeSlots(), (unsigned)(2 * stopCount));
+        return false;
+    }
+    for (size_t i = 0; i < stopCount; i++) {
+        const uint32_t tag = ((uint32_t)orderId << 16) | ((uint32_t)i << 1);
+        MotionSegment seek = { stops[i].compartment, 0, StepRamp::TRAPEZOID, tag, MotionSegment::SEEK };
+        MotionSegment dispense = { stops[i].count, 0, StepRamp::TRAPEZOID, tag | 1, MotionSegment::DISPENSE };
+        if (!task.enqueue(seek) || !task.enqueue(dispense)) {
+            // Room was checked above, only a task that never started fails here
+            Serial.println("[Planner] Motion task not running, plan dropped");
+            return false;
+        }
+    }
+    return true;
+}
+
+long DispensePlanner::endPosition(uint8_t stop) {
+    return motor.compartmentPosition(stopCompartment[stop]) + stopCount[stop] * stepsPerPill;
+}
+
+long DispensePlanner::cost(long fromPosition, uint8_t stop) {
+    return abs(motor.shortestMove(fromPosition, stopCompartment[stop]));
+}
+
+long DispensePlanner::orderCost(long startPosition, const uint8_t* order, size_t count) {
+    long total = 0;
+    long position = startPosition;
+    for (size_t i = 0; i < count; i++) {
+        total += cost(position, order[i]);
+        position = endPosition(order[i]);
+    }
+    return total;
+}
+
+/**
+ * Held-Karp over subsets: bestCost[set][last] is the cheapest way to visit
+ * every stop in set, ending with last.
+ */
+void DispensePlanner::solveExact(long startPosition, uint8_t* order) {
+    const size_t n = stopTotal;
+    if (n == 0) {
+        return;
+    }
+    const uint32_t full = (1u << n) - 1;
+
+    for (uint32_t set = 1; set <= full; set++) {
+        for (uint8_t last = 0; last < n; last++) {
+            if (!(set & (1u << last))) {
+                continue;
+            }
+            const uint32_t rest = set & ~(1u << last);
+            if (rest == 0) {
+                bestCost[set][last] = cost(startPosition, last);
+                bestPrev[set][last] = last;
+                continue;
+            }
+            int32_t best = INT32_MAX;
+            for (uint8_t prev = 0; prev < n; prev++) {
+                if (!(rest & (1u << prev))) {
+                    continue;
+                }
+                const int32_t candidate = bestCost[rest][prev] + cost(endPosition(prev), last);
+                if (candidate < best) {
+                    best = candidate;
+                    bestPrev[set][last] = prev;
+                }
+            }
+            bestCost[set][last] = best;
+        }
+    }
+
+    // Pick the cheapest final stop and walk the predecessors back
+    uint8_t last = 0;
+    for (uint8_t i = 1; i < n; i++) {
+        if (bestCost[full][i] < bestCost[full][last]) {
+            last = i;
+        }
+    }
+    uint32_t set = full;
+    for (size_t i = n; i-- > 0;) {
+        order[i] = last;
+        const uint8_t prev = bestPrev[set][last];
+        set &= ~(1u << last);
+        last = prev;
+    }
+}
+
+/**
+ * Nearest neighbour tour, then swap pairs of stops while that shortens it.
+ */
+void DispensePlanner::solveHeuristic(long startPosition, uint8_t* order) {
+    const size_t n = stopTotal;
+    bool used[COMPARTMENT_COUNT] = {};
+    long position = startPosition;
+
+    for (size_t i = 0; i < n; i++) {
+        uint8_t best = 0;
+        long bestDistance = LONG_MAX;
+        for (uint8_t stop = 0; stop < n; stop++) {
+            if (!used[stop] && cost(position, stop) < bestDistance) {
+                best = stop;
+                bestDistance = cost(position, stop);
+            }
+        }
+        used[best] = true;
+        order[i] = best;
+        position = endPosition(best);
+    }
+
+    long current = orderCost(startPosition, order, n);
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (size_t i = 0; i + 1 < n; i++) {
+            for (size_t j = i + 1; j < n; j++) {
+                std::swap(order[i], order[j]);
+                const long candidate = orderCost(startPosition, order, n);
+                if (candidate < current) {
+                    current = candidate;
+                    improved = true;
+                } else {
+                    std::swap(order[i], order[j]);
+                }
+            }
+        }
+    }
+}
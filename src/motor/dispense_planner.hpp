@@ -0,0 +1,102 @@
+#ifndef DISPENSE_PLANNER_HPP
+#define DISPENSE_PLANNER_HPP
+
+#include <Arduino.h>
+#include "defines.hpp"
+#include "motor.hpp"
+#include "motion_task.hpp"
+
+/**
+ * @brief One (compartment, count) entry of a dispense batch
+ */
+struct DispenseRequest {
+    uint8_t compartment;
+    uint16_t count;
+};
+
+/**
+ * @brief One stop of a planned batch
+ */
+struct DispenseStop {
+    uint8_t compartment;
+    uint16_t count;
+    int32_t travel;         // Predicted signed seek move from the previous stop, in steps
+};
+
+/**
+ * @brief Orders a dispense batch to minimise carousel rotation
+ * 
+ * Requests for the same compartment are merged into one stop. Dispensing
+ * turns the carousel forward by about count * Motor::getStepsPerPill() steps, so the
+ * seek cost between two stops depends on their order (asymmetric). Batches
+ * of up to PLANNER_EXACT_LIMIT stops (see setExactLimit()) are solved
+ * exactly with Held-Karp dynamic programming; larger ones use nearest
+ * neighbour followed by pairwise-swap improvement.
+ * 
+ * Not called by the firmware yet: there is no batch dispense command. A
+ * handler adding one should plan() its batch and enqueue() the stops on
+ * the motion task instead of issuing dispenses in request order.
+ */
+class DispensePlanner {
+public:
+    explicit DispensePlanner(Motor& motor);
+
+    /**
+     * @brief Plan a batch starting from the motor's current position
+     * @param batch Requests in any order
+     * @param batchSize Number of requests
+     * @param stops Output, room for COMPARTMENT_COUNT stops
+     * @return Number of stops written
+     */
+    size_t plan(const DispenseRequest* batch, size_t batchSize, DispenseStop* stops);
+
+    /**
+     * @brief Total seek travel of the last plan in steps
+     */
+    long getTotalTravel() const { return totalTravel; }
+
+    /**
+     * @brief Solve batches of more than limit stops heuristically
+     * 
+     * Defaults to PLANNER_EXACT_LIMIT, the most the Held-Karp tables hold.
+     * Held-Karp takes 2^n * n^2 cost evaluations; lower the limit to bound
+     * planning time.
+     */
+    void setExactLimit(uint8_t limit) { exactLimit = limit < PLANNER_EXACT_LIMIT ? limit : PLANNER_EXACT_LIMIT; }
+
+    /**
+     * @brief Queue a plan as chained segments on a motion task
+     * 
+     * Each stop becomes a SEEK segment and a closed-loop DISPENSE segment. The
+     * seek is resolved when it runs, from wherever the previous dispense
+     * actually stopped, so pill spacing that differs from the plan does
+     * not shift later compartments. Tags are
+     * (orderId << 16) | (stop index << 1) | 1 for dispense segments, 0 for seeks.
+     * A plan is queued completely or not at all.
+     * @return false if the queue has no room for the whole plan
+     */
+    bool enqueue(MotionTask& task, const DispenseStop* stops, size_t stopCount, uint16_t orderId);
+
+private:
+    long endPosition(uint8_t stop);
+    long cost(long fromPosition, uint8_t stop);
+    long orderCost(long startPosition, const uint8_t* order, size_t count);
+    void solveExact(long startPosition, uint8_t* order);
+    void solveHeuristic(long startPosition, uint8_t* order);
+
+    Motor& motor;
+    long stepsPerPill;
+    long totalTravel;
+    uint8_t exactLimit;
+
+    // Merged stops of the batch being planned
+    uint8_t stopCompartment[COMPARTMENT_COUNT];
+    uint16_t stopCount[COMPARTMENT_COUNT];
+    size_t stopTotal;
+
+    // Held-Karp tables, kept out of the task stack
+    int32_t bestCost[1 << PLANNER_EXACT_LIMIT][PLANNER_EXACT_LIMIT];
+    uint8_t bestPrev[1 << PLANNER_EXACT_LIMIT][PLANNER_EXACT_LIMIT];
+};
+
+#endif // DISPENSE_PLANNER_HPP
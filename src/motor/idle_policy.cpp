@@ -0,0 +1,92 @@
+#include "idle_policy.hpp"
+
+#define POWER_FULL 255
+
+IdlePolicy::IdlePolicy()
+    : hook(nullptr),
+      hookArg(nullptr),
+      timer(nullptr),
+      lock(portMUX_INITIALIZER_UNLOCKED),
+      idleTimeoutMs(0),
+      holdLevel(0),
+      level(0),
+      energizedSince(0),
+      energizedTotal(0) {
+}
+
+void IdlePolicy::begin(PowerHook hook, void* arg) {
+    this->hook = hook;
+    this->hookArg = arg;
+
+    if (timer == nullptr) {
+        esp_timer_create_args_t timerArgs = {};
+        timerArgs.callback = &IdlePolicy::onTimer;
+        timerArgs.arg = this;
+        timerArgs.dispatch_method = ESP_TIMER_TASK;
+        timerArgs.name = "motor_idle";
+        if (esp_timer_create(&timerArgs, &timer) != ESP_OK) {
+            timer = nullptr;
+            Serial.println("[Motor] Idle timer creation failed, coils stay powered");
+        }
+    }
+}
+
+void IdlePolicy::configure(unsigned long idleTimeoutMs, uint8_t holdLevel) {
+    this->idleTimeoutMs = idleTimeoutMs;
+    this->holdLevel = holdLevel;
+}
+
+void IRAM_ATTR IdlePolicy::wake() {
+    if (timer != nullptr) {
+        esp_timer_stop(timer);
+    }
+    if (level != POWER_FULL) {
+        apply(POWER_FULL);
+    }
+}
+
+void IRAM_ATTR IdlePolicy::idle() {
+    if (timer == nullptr) {
+        return;
+    }
+    esp_timer_stop(timer);
+    esp_timer_start_once(timer, (uint64_t)idleTimeoutMs * 1000);
+}
+
+void IdlePolicy::release() {
+    if (timer != nullptr) {
+        esp_timer_stop(timer);
+    }
+    apply(0);
+}
+
+uint64_t IdlePolicy::getEnergizedTimeUs() {
+    portENTER_CRITICAL(&lock);
+    uint64_t total = energizedTotal;
+    if (level > 0) {
+        total += esp_timer_get_time() - energizedSince;
+    }
+    portEXIT_CRITICAL(&lock);
+    return total;
+}
+
+void IRAM_ATTR IdlePolicy::apply(uint8_t newLevel) {
+    portENTER_CRITICAL_SAFE(&lock);
+    const int64_t now = esp_timer_get_time();
+    if (level > 0 && newLevel == 0) {
+        energizedTotal += now - energizedSince;
+    } else if (level == 0 && newLevel > 0) {
+        energizedSince = now;
+    }
+    level = newLevel;
+    portEXIT_CRITICAL_SAFE(&lock);
+
+    if (hook != nullptr) {
+        hook(hookArg, newLevel);
+    }
+}
+
+void IdlePolicy::onTimer(void* arg) {
+    IdlePolicy* policy = static_cast<IdlePolicy*>(arg);
+    policy->apply(policy->holdLevel);
+}
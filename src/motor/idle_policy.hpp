@@ -0,0 +1,75 @@
+#ifndef IDLE_POLICY_HPP
+#define IDLE_POLICY_HPP
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+/**
+ * @brief Coil power management of one motor between moves
+ * 
+ * After a move the motor keeps full power for the idle timeout, then drops
+ * to the hold level: a reduced PWM duty on the enable pin, or off when the
+ * hold level is 0. wake() restores full power before the next move.
+ * Energised time (any level above 0) is accumulated per motor.
+ * 
+ * The backend applies levels through a PowerHook: 255 is full power,
+ * 0 releases the coils and values in between are a hold duty.
+ */
+class IdlePolicy {
+public:
+    using PowerHook = void (*)(void* arg, uint8_t level);
+
+    IdlePolicy();
+
+    /**
+     * @brief Create the idle timer and set the hook applying power levels
+     */
+    void begin(PowerHook hook, void* arg);
+
+    /**
+     * @brief Configure the policy
+     * @param idleTimeoutMs Full power is kept this long after a move
+     * @param holdLevel Level after the timeout, 0 releases the coils
+     */
+    void configure(unsigned long idleTimeoutMs, uint8_t holdLevel);
+
+    /**
+     * @brief Restore full power before a move (fast path if already full)
+     */
+    void wake();
+
+    /**
+     * @brief A move has ended, start the idle timeout (ISR-safe)
+     */
+    void idle();
+
+    /**
+     * @brief Release the coils right away
+     */
+    void release();
+
+    bool isEnergized() const { return level > 0; }
+
+    /**
+     * @brief Total time the coils were powered, in microseconds
+     */
+    uint64_t getEnergizedTimeUs();
+
+private:
+    void apply(uint8_t newLevel);
+    static void onTimer(void* arg);
+
+    PowerHook hook;
+    void* hookArg;
+    esp_timer_handle_t timer;
+    portMUX_TYPE lock;
+
+    unsigned long idleTimeoutMs;
+    uint8_t holdLevel;
+    volatile uint8_t level;
+
+    int64_t energizedSince;
+    uint64_t energizedTotal;
+};
+
+#endif // IDLE_POLICY_HPP
@@ -0,0 +1,160 @@
+#include "motion_task.hpp"
+
+MotionTask::MotionTask()
+    : motor(nullptr),
+      task(nullptr),
+      moveDone(nullptr),
+      completionCallback(nullptr),
+      busy(false),
+      acceleration(0),
+      currentSpeed(0),
+      currentProfile(StepRamp::CONSTANT) {
+}
+
+bool MotionTask::begin(Motor* motor, long acceleration) {
+    if (task != nullptr) {
+        Serial.println("[Motion] Task already running");
+        return false;
+    }
+
+    this->motor = motor;
+    this->acceleration = acceleration;
+    moveDone = xSemaphoreCreateBinary();
+    motor->setCompletionCallback(&MotionTask::onMoveDone, this);
+
+    // Pin away from loop() and the bus receive task on core 1. Core 0 is
+    // shared with the WiFi/lwIP tasks, which preempt this one; that is fine
+    // as the task only starts moves and waits, the steps come from the
+    // StepMove timer or the RMT peripheral
+    BaseType_t created = xTaskCreatePinnedToCore(
+        taskEntry,          // Task function
+        "motionTask",       // Task name (for debugging)
+        4096,               // Stack size in bytes
+        this,               // Task parameter
+        5,                  // Priority (above loop and LED task)
+        &task,              // Task handle for notifications
+        MOTION_TASK_CORE    // Core ID (0 or 1)
+    );
+    if (created != pdPASS) {
+        Serial.println("[Motion] Failed to create motion task");
+        task = nullptr;
+        return false;
+    }
+
+    Serial.printf("[Motion] Motion task started on core %d\n", MOTION_TASK_CORE);
+    return true;
+}
+
+bool MotionTask::enqueue(const MotionSegment& segment) {
+    if (task == nullptr || !queue.push(segment)) {
+        return false;
+    }
+    xTaskNotifyGive(task);
+    return true;
+}
+
+bool MotionTask::isIdle() {
+    // busy is raised before a segment leaves the queue, so checking the
+    // queue first cannot miss one in flight
+    if (!queue.empty()) {
+        return false;
+    }
+    return !busy;
+}
+
+void MotionTask::setCompletionCallback(CompletionCallback callback) {
+    completionCallback = callback;
+}
+
+void MotionTask::taskEntry(void* param) {
+    static_cast<MotionTask*>(param)->run();
+}
+
+void MotionTask::run() {
+    for (;;) {
+        MotionSegment segment;
+        busy = true;
+        if (!queue.pop(segment)) {
+            busy = false;
+            // Sleep until the producer signals a new segment
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        apply(segment);
+        const bool completed = execute(segment);
+
+        if (completionCallback != nullptr) {
+            completionCallback(segment.tag, completed);
+        }
+    }
+}
+
+bool MotionTask::execute(const MotionSegment& segment) {
+    // A seek to the compartment already in place starts no move to wait for
+    const bool moves = segment.mode == MotionSegment::SEEK
+        ? !motor->isHomed() || motor->shortestMove(motor->getPosition(), (uint8_t)segment.steps) != 0
+        : segment.steps != 0;
+    if (!moves) {
+        return true;
+    }
+
+    // A move started outside the queue is replaced and reports its end, let
+    // it do so and drop that completion before starting, then wait for this one
+    if (motor->isRunning()) {
+        motor->stop();
+        xSemaphoreTake(moveDone, pdMS_TO_TICKS(100));
+    }
+    xSemaphoreTake(moveDone, 0);
+    bool started;
+    if (segment.mode == MotionSegment::DISPENSE) {
+        started = motor->dispense((uint16_t)segment.steps);
+    } else if (segment.mode == MotionSegment::SEEK) {
+        started = motor->seek((uint8_t)segment.steps);
+    } else {
+        started = motor->moveAsync(segment.steps);
+    }
+    if (!started) {
+        Serial.printf("[Motion] Segment %08X not started\n", (unsigned)segment.tag);
+        return false;
+    }
+    if (xSemaphoreTake(moveDone, pdMS_TO_TICKS(MOTION_SEGMENT_TIMEOUT)) != pdTRUE) {
+        // Stopping ends the move after its current step
+        Serial.printf("[Motion] Segment %08X timed out, stopping\n", (unsigned)segment.tag);
+        motor->stop();
+        xSemaphoreTake(moveDone, pdMS_TO_TICKS(100));
+        return false;
+    }
+    if (segment.mode == MotionSegment::DISPENSE && motor->getDispensedCount() < segment.steps) {
+        // The overrun bound ended the move: empty compartment or jammed pills
+        Serial.printf("[Motion] Segment %08X dispensed %u of %u pills\n", (unsigned)segment.tag,
+                      (unsigned)motor->getDispensedCount(), (unsigned)segment.steps);
+        return false;
+    }
+    return true;
+}
+
+void MotionTask::apply(const MotionSegment& segment) {
+    // Rebuilding a ramp is expensive, only do it when something changed
+    if (segment.speed != 0 && segment.speed != currentSpeed) {
+        motor->setSpeed(segment.speed);
+        currentSpeed = segment.speed;
+    }
+    if (segment.profile != currentProfile) {
+        motor->setAcceleration(acceleration, (StepRamp::Profile)segment.profile);
+        currentProfile = segment.profile;
+    }
+}
+
+void IRAM_ATTR MotionTask::onMoveDone(void* arg) {
+    MotionTask* self = static_cast<MotionTask*>(arg);
+
+    // Motors finish from the esp_timer task or from an interrupt
+    if (xPortInIsrContext()) {
+        BaseType_t woken = pdFALSE;
+        xSemaphoreGiveFromISR(self->moveDone, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xSemaphoreGive(self->moveDone);
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef MOTION_TASK_HPP
+#define MOTION_TASK_HPP
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include "defines.hpp"
+#include "spsc_ring.hpp"
+#include "motor.hpp"
+
+/**
+ * @brief One queued move of a MotionTask
+ */
+struct MotionSegment {
+    enum Mode : uint8_t {
+        MOVE,           // Open-loop move of steps
+        DISPENSE,       // Closed-loop dispense of steps pills
+        SEEK            // Motor::seek() to compartment steps
+    };
+
+    int32_t steps;      // Relative steps, negative reverses (pill count for DISPENSE, compartment for SEEK)
+    uint16_t speed;     // Speed in RPM, 0 keeps the current speed
+    uint8_t profile;    // StepRamp::Profile of this segment
+    uint32_t tag;       // Reported through the completion callback
+    Mode mode;
+};
+
+/**
+ * @brief Motion task draining a lock-free queue of move segments
+ * 
+ * The producer enqueues segments without blocking; a FreeRTOS task pinned
+ * to MOTION_TASK_CORE starts each segment as soon as the previous one has
+ * finished. Speed and profile are only reconfigured when they change, so
+ * consecutive segments run back to back.
+ * 
+ * The queue is single-producer: enqueue() must always be called from the
+ * same task (the Arduino loop).
+ */
+class MotionTask {
+public:
+    /**
+     * @brief Callback type for finished segments
+     * @param tag Tag of the segment that finished
+     * @param completed false if the segment could not be started, timed
+     *                  out or dispensed fewer pills than requested
+     */
+    using CompletionCallback = std::function<void(uint32_t tag, bool completed)>;
+
+    MotionTask();
+
+    /**
+     * @brief Start the motion task for a motor
+     * @param motor Initialized motor driven by this task
+     * @param acceleration Acceleration in steps/s^2 used for ramped profiles
+     * @return true if the task was created
+     */
+    bool begin(Motor* motor, long acceleration = MOTION_DEFAULT_ACCELERATION);
+
+    /**
+     * @brief Queue a segment
+     * @return false if the queue is full
+     */
+    bool enqueue(const MotionSegment& segment);
+
+    /**
+     * @brief Segments that can still be queued (producer side)
+     * 
+     * Only grows until the next enqueue(), so a batch that fits now can be
+     * queued completely.
+     */
+    size_t freeSlots() const { return queue.capacity() - queue.size(); }
+
+    /**
+     * @brief Check if the queue is empty and no segment is running
+     */
+    bool isIdle();
+
+    /**
+     * @brief Set callback for finished segments (runs in the motion task)
+     */
+    void setCompletionCallback(CompletionCallback callback);
+
+private:
+    static void taskEntry(void* param);
+    void run();
+    void apply(const MotionSegment& segment);
+
+    /**
+     * @brief Start a segment and wait until it has finished
+     * @return true if it ran to completion
+     */
+    bool execute(const MotionSegment& segment);
+
+    /**
+     * @brief Motor completion hook, wakes the motion task
+     */
+    static void IRAM_ATTR onMoveDone(void* arg);
+
+    Motor* motor;
+    TaskHandle_t task;
+    SemaphoreHandle_t moveDone;
+    SpscRing<MotionSegment, MOTION_QUEUE_SIZE> queue;
+    CompletionCallback completionCallback;
+
+    std::atomic<bool> busy;     // raised before popping a segment
+    long acceleration;
+    uint16_t currentSpeed;
+    uint8_t currentProfile;
+};
+
+#endif // MOTION_TASK_HPP
@@ -0,0 +1,198 @@
+#include "motor.hpp"
+#include <Arduino.h>
+
+Motor::Motor() {
+    // Spread the compartments evenly until the real layout is configured
+    for (uint8_t i = 0; i < COMPARTMENT_COUNT; i++) {
+        compartmentAngles[i] = (uint16_t)((36000UL * i) / COMPARTMENT_COUNT);
+    }
+}
+
+bool Motor::home(unsigned long timeoutMs) {
+    const long revolution = getStepsPerRevolution();
+    homed = false;
+
+    // Leave the sensor first so the falling edge can be seen
+    if (digitalRead(HOME_PIN) == LOW) {
+        step(-revolution / 8);
+    }
+
+    if (!startEventTask()) {
+        Serial.println("[Motor] Homing failed, no event task");
+        return false;
+    }
+    homeTriggered = false;
+    attachInterruptArg(digitalPinToInterrupt(HOME_PIN), homeISR, this, FALLING);
+    if (!moveAsync(revolution + revolution / 4)) {
+        detachInterrupt(digitalPinToInterrupt(HOME_PIN));
+        Serial.println("[Motor] Homing failed, motor not ready");
+        return false;
+    }
+
+    const unsigned long start = millis();
+    while (isRunning() && !homeTriggered && millis() - start < timeoutMs) {
+        vTaskDelay(1);
+    }
+    detachInterrupt(digitalPinToInterrupt(HOME_PIN));
+
+    // The event task stops the move on the sensor edge; on a timeout or a
+    // move that ended first, make sure it is over in every case
+    stop();
+    while (isRunning()) {
+        vTaskDelay(1);
+    }
+
+    if (!homeTriggered) {
+        Serial.println("[Motor] Homing failed, sensor not found");
+        return false;
+    }
+
+    // Steps taken after the edge keep counting from the sensor position
+    setPosition(getPosition() - homeTriggerPosition);
+    homed = true;
+    Serial.printf("[Motor] Homed, overshoot %ld steps\n", getPosition());
+    return true;
+}
+
+void Motor::setCompartmentAngle(uint8_t compartment, float degrees) {
+    if (compartment >= COMPARTMENT_COUNT || degrees < 0 || degrees >= 360) {
+        return;
+    }
+    compartmentAngles[compartment] = (uint16_t)(degrees * 100.0f + 0.5f);
+}
+
+long Motor::compartmentPosition(uint8_t compartment) {
+    if (compartment >= COMPARTMENT_COUNT) {
+        return 0;
+    }
+    return (long)(((int64_t)compartmentAngles[compartment] * getStepsPerRevolution()) / 36000);
+}
+
+long Motor::shortestMove(long fromPosition, uint8_t compartment) {
+    const long revolution = getStepsPerRevolution();
+
+    // Wrap both into one revolution, then pick the shorter way round
+    long current = fromPosition % revolution;
+    if (current < 0) {
+        current += revolution;
+    }
+    long delta = compartmentPosition(compartment) - current;
+    if (delta > revolution / 2) {
+        delta -= revolution;
+    } else if (delta <= -revolution / 2) {
+        delta += revolution;
+    }
+    return delta;
+}
+
+bool Motor::seek(uint8_t compartment) {
+    if (!homed || compartment >= COMPARTMENT_COUNT) {
+        return false;
+    }
+
+    const long delta = shortestMove(getPosition(), compartment);
+    return delta == 0 || moveAsync(delta);
+}
+
+int Motor::currentCompartment() {
+    if (!homed) {
+        return -1;
+    }
+    for (uint8_t i = 0; i < COMPARTMENT_COUNT; i++) {
+        if (shortestMove(getPosition(), i) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void Motor::setIdlePolicy(unsigned long idleTimeoutMs, uint8_t holdDuty) {
+    idlePolicy.configure(idleTimeoutMs, holdDuty);
+}
+
+void Motor::release() {
+    if (!isRunning()) {
+        idlePolicy.release();
+    }
+}
+
+void Motor::setPillSensor(PillSensor* sensor) {
+    if (pillSensor != nullptr) {
+        pillSensor->detach();
+    }
+    pillSensor = sensor;
+    if (pillSensor != nullptr) {
+        pillSensor->attach(pillISR, this);
+    }
+}
+
+bool Motor::dispense(uint16_t count) {
+    if (pillSensor == nullptr || isrPosition == nullptr || count == 0) {
+        return false;
+    }
+
+    pillCounter.arm(count, getPosition(), DISPENSE_MIN_PILL_SPACING);
+    if (!moveAsync((int)(count * getStepsPerPill() * DISPENSE_OVERRUN_FACTOR))) {
+        pillCounter.disarm();
+        return false;
+    }
+    return true;
+}
+
+long Motor::getStepsPerPill() const {
+    const long observed = pillCounter.getStepsPerPill();
+    return observed > 0 ? observed : DISPENSE_STEPS_PER_PILL;
+}
+
+bool Motor::startEventTask() {
+    if (eventTask != nullptr) {
+        return true;
+    }
+    BaseType_t created = xTaskCreatePinnedToCore(
+        eventTaskEntry,             // Task function
+        "motorEvents",              // Task name (for debugging)
+        2048,                       // Stack size in bytes
+        this,                       // Task parameter
+        MOTOR_EVENT_TASK_PRIORITY,  // Above the motion task
+        &eventTask,                 // Task handle for ISR notifications
+        MOTION_TASK_CORE            // Core ID (0 or 1)
+    );
+    if (created != pdPASS) {
+        eventTask = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void Motor::eventTaskEntry(void* arg) {
+    Motor* motor = static_cast<Motor*>(arg);
+    for (;;) {
+        uint32_t events = 0;
+        xTaskNotifyWait(0, ULONG_MAX, &events, portMAX_DELAY);
+
+        if ((events & EVENT_HOME) && !motor->homeTriggered) {
+            motor->homeTriggerPosition = motor->getPosition();
+            motor->homeTriggered = true;
+            motor->stop();
+        }
+    }
+}
+
+void IRAM_ATTR Motor::pillISR(void* arg) {
+    Motor* motor = static_cast<Motor*>(arg);
+    if (motor->isrPosition == nullptr) {
+        return;
+    }
+    // Counted and stopped right here, so no task latency lets further
+    // steps through once the target pill has dropped
+    if (motor->pillCounter.onPillDetected(motor->isrPosition(motor))) {
+        motor->isrStop(motor);
+    }
+}
+
+void IRAM_ATTR Motor::homeISR(void* arg) {
+    Motor* motor = static_cast<Motor*>(arg);
+    BaseType_t woken = pdFALSE;
+    xTaskNotifyFromISR(motor->eventTask, EVENT_HOME, eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
+}
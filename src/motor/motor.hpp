@@ -1,10 +1,237 @@
 #pragma once
 
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "defines.hpp"
+#include "stepper/StepRamp.h"
+#include "pill_counter.hpp"
+#include "pill_sensor.hpp"
+#include "idle_policy.hpp"
+
+/**
+ * @brief Motor interface for one dispensing carousel
+ *
+ * Implemented by StepperMotor (coils driven directly through the Stepper
+ * library) and StepDirMotor (STEP/DIR driver chips fed by the RMT
+ * peripheral). Speeds are given in revolutions per minute.
+ *
+ * On top of the backend primitives the base class keeps an absolute
+ * position model: home() zeroes the position on the HOME_PIN sensor and
+ * seek() turns the carousel to a compartment along the shorter direction.
+ */
 class Motor {
     public:
+        /**
+         * @brief Called when a move started with moveAsync() ends
+         *
+         * Runs in timer or interrupt context; keep it short, ISR-safe and
+         * IRAM_ATTR.
+         */
+        typedef void (*CompletionCallback)(void* arg);
+
         Motor();
-        void initialize();
-        void setSpeed(double speed);
-        void step(int steps);
-        void stop();
-};
\ No newline at end of file
+        virtual ~Motor() {}
+
+        virtual void initialize() = 0;
+        virtual void setSpeed(double speed) = 0;
+
+        /**
+         * @brief Set acceleration and ramp profile for following moves
+         * @param acceleration Acceleration in steps/s^2
+         * @param profile TRAPEZOID, S_CURVE or CONSTANT (no ramp)
+         */
+        virtual void setAcceleration(long acceleration, StepRamp::Profile profile = StepRamp::TRAPEZOID) = 0;
+
+        /**
+         * @brief Move and block until the move has finished
+         */
+        virtual void step(int steps) = 0;
+
+        /**
+         * @brief Start a move and return immediately
+         *
+         * Steps are emitted by a timer or peripheral, so the calling task
+         * keeps running.
+         * @param steps Number of steps, negative values reverse the direction
+         * @return true if a move was started and its completion callback
+         *         will run; false for zero steps or a motor that is not ready
+         */
+        virtual bool moveAsync(int steps) = 0;
+
+        /**
+         * @brief Check whether a move started with moveAsync() is still running
+         */
+        virtual bool isRunning() = 0;
+
+        virtual void stop() = 0;
+
+        /**
+         * @brief Register a function called whenever an async move ends
+         */
+        virtual void setCompletionCallback(CompletionCallback callback, void* arg) = 0;
+
+        /**
+         * @brief Absolute position in steps since the last home()/setPosition()
+         */
+        virtual long getPosition() = 0;
+        virtual void setPosition(long position) = 0;
+        virtual long getStepsPerRevolution() = 0;
+
+        // ====================================================================
+        // Position model
+        // ====================================================================
+
+        /**
+         * @brief Find the home sensor and define it as position 0
+         *
+         * Turns forward at the current speed for at most 1.25 revolutions
+         * until HOME_PIN goes LOW. Blocks; call while no other move runs.
+         * @param timeoutMs Give up after this many milliseconds
+         * @return true if the sensor was found
+         */
+        bool home(unsigned long timeoutMs = MOTOR_HOME_TIMEOUT);
+
+        bool isHomed() const { return homed; }
+
+        /**
+         * @brief Set the carousel angle of a compartment
+         * @param compartment Compartment index below COMPARTMENT_COUNT
+         * @param degrees Angle from the home position, 0 to 360
+         */
+        void setCompartmentAngle(uint8_t compartment, float degrees);
+
+        /**
+         * @brief Step position of a compartment within one revolution
+         */
+        long compartmentPosition(uint8_t compartment);
+
+        /**
+         * @brief Shortest signed move from a position to a compartment
+         *
+         * Never longer than half a revolution.
+         * @param fromPosition Absolute start position in steps
+         * @param compartment Target compartment
+         */
+        long shortestMove(long fromPosition, uint8_t compartment);
+
+        /**
+         * @brief Turn to a compartment along the shorter direction
+         *
+         * Starts an asynchronous move; poll isRunning() for the end.
+         * @return false if not homed, the compartment is out of range or
+         *         the move could not be started
+         */
+        bool seek(uint8_t compartment);
+
+        /**
+         * @brief Compartment at the current position, or -1 if in between
+         */
+        int currentCompartment();
+
+        // ====================================================================
+        // Closed-loop dispensing
+        // ====================================================================
+
+        /**
+         * @brief Use a pill-drop sensor for dispense()
+         */
+        void setPillSensor(PillSensor* sensor);
+
+        /**
+         * @brief Turn forward until count pills have been detected
+         *
+         * Starts an asynchronous move bounded by DISPENSE_OVERRUN_FACTOR
+         * times the expected rotation. The sensor interrupt counts the
+         * pills and stops the move on the count-th one.
+         * @return false without a sensor, for a zero count or if the move
+         *         could not be started
+         */
+        bool dispense(uint16_t count);
+
+        /**
+         * @brief Pills detected during the last dispense()
+         */
+        uint16_t getDispensedCount() const { return pillCounter.getCount(); }
+
+        /**
+         * @brief Observed steps per pill, DISPENSE_STEPS_PER_PILL until measured
+         */
+        long getStepsPerPill() const;
+
+        // ====================================================================
+        // Coil power between moves
+        // ====================================================================
+
+        /**
+         * @brief Configure what happens to the coils after a move
+         * @param idleTimeoutMs Full power is kept this long after a move
+         * @param holdDuty PWM duty (1-255) on the enable pin afterwards,
+         *                 0 releases the coils completely
+         */
+        void setIdlePolicy(unsigned long idleTimeoutMs, uint8_t holdDuty);
+
+        /**
+         * @brief Switch the coils off now; the next move re-energises them
+         */
+        void release();
+
+        /**
+         * @brief Total time this motor's coils were powered, in microseconds
+         */
+        uint64_t getEnergizedTimeUs() { return idlePolicy.getEnergizedTimeUs(); }
+
+    protected:
+        typedef long (*IsrPosition)(Motor* motor);
+        typedef void (*IsrStop)(Motor* motor);
+
+        /**
+         * @brief Let the pill sensor interrupt read the position and end the move
+         *
+         * Called by the backend constructor. Both functions run in the
+         * interrupt, so they must be IRAM_ATTR and only touch the backend's
+         * move state; they are plain function pointers because vtables live
+         * in flash. The stop must take effect without waiting for a task.
+         */
+        void setIsrAccess(IsrPosition position, IsrStop stop) {
+            isrPosition = position;
+            isrStop = stop;
+        }
+
+        IdlePolicy idlePolicy;
+
+    private:
+        /**
+         * @brief Notification bits of the event task
+         */
+        enum Event : uint32_t {
+            EVENT_HOME = 0x01   ///< HOME_PIN fell during home()
+        };
+
+        /**
+         * @brief Start the task handling home sensor events, once
+         *
+         * The home ISR only notifies the edge; reading the position and
+         * stopping the move (which touches timers and virtual backend code
+         * outside IRAM) happens in task context.
+         */
+        bool startEventTask();
+        static void eventTaskEntry(void* arg);
+
+        static void homeISR(void* arg);
+        static void pillISR(void* arg);
+
+        TaskHandle_t eventTask = nullptr;
+        IsrPosition isrPosition = nullptr;
+        IsrStop isrStop = nullptr;
+
+        PillSensor* pillSensor = nullptr;
+        PillCounter pillCounter;
+
+        // Compartment angles in 1/100 degree
+        uint16_t compartmentAngles[COMPARTMENT_COUNT];
+
+        bool homed = false;
+        volatile bool homeTriggered = false;
+        volatile long homeTriggerPosition = 0;
+};
@@ -0,0 +1,89 @@
+#ifndef PILL_COUNTER_HPP
+#define PILL_COUNTER_HPP
+
+#include <stdint.h>
+#include <esp_attr.h>
+
+/**
+ * @brief Counts pill-drop detections during a dispense move
+ * 
+ * Fed from the pill sensor interrupt with the motor position of every
+ * detection. Reports when the target count is reached so the move can be
+ * stopped right away, and keeps a running average of the steps between
+ * consecutive pills. The first pill of a dispense only starts the spacing
+ * measurement, its distance from the start position depends on where the
+ * previous dispense stopped. Free of Arduino dependencies apart from
+ * IRAM_ATTR so it can be driven on the host.
+ */
+class PillCounter {
+public:
+    /**
+     * @brief Start counting towards a target
+     * @param target Pills to dispense
+     * @param startPosition Motor position when the dispense move starts
+     * @param minSpacing Detections closer than this many steps to the
+     *                   start or the previous pill are bounces
+     */
+    void arm(uint16_t target, long startPosition, long minSpacing) {
+        this->target = target;
+        this->minSpacing = minSpacing;
+        lastPosition = startPosition;
+        count = 0;
+        armed = target > 0;
+    }
+
+    void disarm() { armed = false; }
+
+    /**
+     * @brief Register one detection
+     * 
+     * Called from the sensor interrupt. There is no locking; arm() is
+     * called by the task starting the dispense, before the move begins.
+     * 
+     * @param position Motor position at the detection
+     * @return true exactly once, when the target count has been reached
+     */
+    IRAM_ATTR bool onPillDetected(long position) {
+        if (!armed) {
+            return false;
+        }
+        const long spacing = position > lastPosition ? position - lastPosition : lastPosition - position;
+        if (spacing < minSpacing) {
+            return false;
+        }
+
+        // Running average of steps per pill in 1/16 step, weight 1/4
+        if (count > 0) {
+            const long sample = spacing * 16;
+            averageScaled = averageScaled == 0 ? sample : averageScaled + (sample - averageScaled) / 4;
+        }
+
+        lastPosition = position;
+        count++;
+        if (count >= target) {
+            armed = false;
+            return true;
+        }
+        return false;
+    }
+
+    bool isArmed() const { return armed; }
+    bool isComplete() const { return count >= target; }
+    uint16_t getCount() const { return count; }
+
+    /**
+     * @brief Observed steps between pills, 0 until two pills of one
+     *        dispense have been seen
+     */
+    long getStepsPerPill() const { return (averageScaled + 8) / 16; }
+
+private:
+    volatile bool armed = false;
+    volatile uint16_t count = 0;
+    uint16_t target = 0;
+    long minSpacing = 0;
+    volatile long lastPosition = 0;
+    volatile long averageScaled = 0;
+};
+
+#endif // PILL_COUNTER_HPP
@@ -0,0 +1,11 @@
+#include "pill_sensor.hpp"
+#include <Arduino.h>
+
+void GpioPillSensor::attach(EdgeHandler handler, void* arg) {
+    pinMode(pin, INPUT);
+    attachInterruptArg(digitalPinToInterrupt(pin), handler, arg, FALLING);
+}
+
+void GpioPillSensor::detach() {
+    detachInterrupt(digitalPinToInterrupt(pin));
+}
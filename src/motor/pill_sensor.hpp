@@ -0,0 +1,57 @@
+#ifndef PILL_SENSOR_HPP
+#define PILL_SENSOR_HPP
+
+#include <stdint.h>
+
+/**
+ * @brief Source of pill-drop edges
+ * 
+ * The handler runs in interrupt context for the GPIO sensor; keep it
+ * ISR-safe.
+ */
+class PillSensor {
+public:
+    using EdgeHandler = void (*)(void* arg);
+
+    virtual ~PillSensor() {}
+    virtual void attach(EdgeHandler handler, void* arg) = 0;
+    virtual void detach() = 0;
+};
+
+/**
+ * @brief Pill-drop light barrier on a GPIO (falling edge = pill)
+ */
+class GpioPillSensor : public PillSensor {
+public:
+    explicit GpioPillSensor(uint8_t pin) : pin(pin) {}
+    void attach(EdgeHandler handler, void* arg) override;
+    void detach() override;
+
+private:
+    uint8_t pin;
+};
+
+/**
+ * @brief Edge source for host tests, trigger() simulates a detected pill
+ */
+class SimulatedPillSensor : public PillSensor {
+public:
+    void attach(EdgeHandler handler, void* arg) override {
+        this->handler = handler;
+        this->arg = arg;
+    }
+
+    void detach() override { handler = nullptr; }
+
+    void trigger() {
+        if (handler != nullptr) {
+            handler(arg);
+        }
+    }
+
+private:
+    EdgeHandler handler = nullptr;
+    void* arg = nullptr;
+};
+
+#endif // PILL_SENSOR_HPP
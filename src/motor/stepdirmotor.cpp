@@ -0,0 +1,257 @@
+#include "stepdirmotor.hpp"
+#include <Arduino.h>
+#include <defines.hpp>
+
+// RMT tick is 1 us with the 80 MHz APB clock
+#define STEPDIR_RMT_CLK_DIV 80
+
+// Width of the high part of each STEP pulse in us
+#define STEPDIR_PULSE_US 2
+
+// Longest duration of one RMT item half
+#define STEPDIR_MAX_DURATION 32767
+
+StepDirMotor* StepDirMotor::channelOwners[RMT_CHANNEL_MAX] = {};
+
+// The translator never reads its source buffer: every "sample" stands for one
+// step, so a move of n steps is queued as n bytes starting at this address.
+static const uint8_t stepSamples[1] = {0};
+
+StepDirMotor::StepDirMotor()
+    : StepDirMotor(MOTOR_STEP_PIN, MOTOR_DIR_PIN, MOTOR_ENABLE_PIN,
+                   MOTOR_STEPS * MOTOR_MICROSTEPS, RMT_CHANNEL_0) {
+}
+
+StepDirMotor::StepDirMotor(int stepPin, int dirPin, int enablePin, int stepsPerRevolution, rmt_channel_t channel)
+    : stepPin(stepPin),
+      dirPin(dirPin),
+      enablePin(enablePin),
+      stepsPerRevolution(stepsPerRevolution),
+      channel(channel) {
+    setIsrAccess(&StepDirMotor::positionFromISR, &StepDirMotor::stopFromISR);
+}
+
+void StepDirMotor::initialize() {
+    pinMode(dirPin, OUTPUT);
+    if (enablePin >= 0) {
+        // Driver outputs are enabled while ENABLE is LOW
+        pinMode(enablePin, OUTPUT);
+    }
+
+    // Driver starts disabled and is enabled by the first move
+    idlePolicy.begin(&StepDirMotor::applyPower, this);
+    idlePolicy.configure(MOTOR_IDLE_TIMEOUT, MOTOR_HOLD_DUTY);
+    idlePolicy.release();
+
+    if (!installed) {
+        rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)stepPin, channel);
+        config.clk_div = STEPDIR_RMT_CLK_DIV;
+        config.tx_config.idle_output_en = true;
+        config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+
+        if (rmt_config(&config) != ESP_OK || rmt_driver_install(channel, 0, 0) != ESP_OK) {
+            Serial.printf("[Motor] RMT channel %d setup failed\n", (int)channel);
+            return;
+        }
+        rmt_translator_init(channel, &StepDirMotor::translate);
+        rmt_translator_set_context(channel, this);
+
+        // The end callback is shared by all channels, dispatch by channel
+        channelOwners[channel] = this;
+        rmt_register_tx_end_callback(&StepDirMotor::onTxEnd, nullptr);
+        installed = true;
+    }
+
+    setSpeed(30);
+}
+
+void StepDirMotor::setSpeed(double speed) {
+    if (speed <= 0) {
+        return;
+    }
+    stepDelay = (unsigned long)(60.0 * 1000.0 * 1000.0 / stepsPerRevolution / speed);
+    ramp.configure(profile, stepDelay, acceleration);
+}
+
+void StepDirMotor::setAcceleration(long acceleration, StepRamp::Profile profile) {
+    this->acceleration = acceleration;
+    this->profile = profile;
+    ramp.configure(profile, stepDelay, acceleration);
+}
+
+void StepDirMotor::step(int steps) {
+    if (!moveAsync(steps)) {
+        return;
+    }
+    while (running) {
+        vTaskDelay(1);
+    }
+}
+
+bool StepDirMotor::moveAsync(int steps) {
+    if (!installed || steps == 0) {
+        return false;
+    }
+
+    // Let a running move drain first, the RMT channel holds only one
+    if (running) {
+        stop();
+        rmt_wait_tx_done(channel, portMAX_DELAY);
+    }
+
+    idlePolicy.wake();
+
+    direction = steps > 0 ? 1 : -1;
+    digitalWrite(dirPin, steps > 0 ? HIGH : LOW);
+    delayMicroseconds(1); // DIR setup time before the first STEP edge
+
+    stepsTotal = abs(steps);
+    stepsDone = 0;
+    spill = 0;
+    stopRequested = false;
+    running = true;
+    if (rmt_write_sample(channel, stepSamples, (size_t)stepsTotal, false) != ESP_OK) {
+        running = false;
+        idlePolicy.idle();
+        return false;
+    }
+    return true;
+}
+
+bool StepDirMotor::isRunning() {
+    return running;
+}
+
+void StepDirMotor::stop() {
+    // The translator drops all remaining steps on its next refill; the end
+    // of transmission then starts the idle timeout
+    if (running) {
+        stopRequested = true;
+    } else {
+        idlePolicy.idle();
+    }
+}
+
+void StepDirMotor::setCompletionCallback(CompletionCallback callback, void* arg) {
+    completionCallback = callback;
+    completionArg = arg;
+}
+
+long StepDirMotor::getPosition() {
+    return position;
+}
+
+void StepDirMotor::setPosition(long position) {
+    this->position = position;
+}
+
+long StepDirMotor::getStepsPerRevolution() {
+    return stepsPerRevolution;
+}
+
+/**
+ * Turns steps into RMT items from the driver interrupt. Each step is a
+ * STEPDIR_PULSE_US high pulse followed by the low time of its ramp interval;
+ * low time beyond one item half spills into all-low items, carried over to
+ * the next call when the buffer is full.
+ */
+void IRAM_ATTR StepDirMotor::translate(const void* src, rmt_item32_t* dest, size_t srcSize,
+                                       size_t wantedNum, size_t* translatedSize, size_t* itemNum) {
+    void* context = nullptr;
+    rmt_translator_get_context(itemNum, &context);
+    StepDirMotor* motor = static_cast<StepDirMotor*>(context);
+
+    size_t steps = 0;
+
+    if (motor == nullptr || motor->stopRequested) {
+        // Consume everything without output so the transmission ends
+        if (motor != nullptr) {
+            motor->spill = 0;
+        }
+        *translatedSize = srcSize;
+        *itemNum = 0;
+        return;
+    }
+
+    // Low time left over from the last step of the previous call
+    size_t items = fillSpill(motor, dest, wantedNum);
+
+    while (steps < srcSize && items < wantedNum && motor->spill == 0) {
+        const int done = motor->stepsDone;
+        const uint32_t interval = motor->ramp.interval(done, motor->stepsTotal - 1 - done);
+
+        // A zero duration is the end marker, so every half lasts at least 1 us
+        const uint32_t low = interval > STEPDIR_PULSE_US + 1 ? interval - STEPDIR_PULSE_US : 1;
+        uint32_t first = low;
+        if (low > STEPDIR_MAX_DURATION) {
+            first = STEPDIR_MAX_DURATION;
+            // An all-low item needs 2 us, take a shorter remainder from here
+            if (low - first < 2) {
+                first = low - 2;
+            }
+        }
+        dest[items].duration0 = STEPDIR_PULSE_US;
+        dest[items].level0 = 1;
+        dest[items].duration1 = first;
+        dest[items].level1 = 0;
+        items++;
+
+        motor->spill = low - first;
+        motor->stepsDone = done + 1;
+        motor->position += motor->direction;
+        steps++;
+
+        items += fillSpill(motor, dest + items, wantedNum - items);
+    }
+
+    *translatedSize = steps;
+    *itemNum = items;
+}
+
+size_t IRAM_ATTR StepDirMotor::fillSpill(StepDirMotor* motor, rmt_item32_t* dest, size_t wantedNum) {
+    size_t items = 0;
+    while (motor->spill > 0 && items < wantedNum) {
+        uint32_t chunk = motor->spill < 2 * STEPDIR_MAX_DURATION ? motor->spill : 2 * STEPDIR_MAX_DURATION;
+        // Never leave a single microsecond for the last item
+        if (motor->spill - chunk == 1) {
+            chunk--;
+        }
+        dest[items].duration0 = chunk >> 1;
+        dest[items].level0 = 0;
+        dest[items].duration1 = chunk - (chunk >> 1);
+        dest[items].level1 = 0;
+        items++;
+        motor->spill -= chunk;
+    }
+    return items;
+}
+
+void IRAM_ATTR StepDirMotor::onTxEnd(rmt_channel_t channel, void* arg) {
+    StepDirMotor* motor = channelOwners[channel];
+    if (motor != nullptr) {
+        motor->running = false;
+        motor->idlePolicy.idle();
+        if (motor->completionCallback != nullptr) {
+            motor->completionCallback(motor->completionArg);
+        }
+    }
+}
+
+long IRAM_ATTR StepDirMotor::positionFromISR(Motor* motor) {
+    return static_cast<StepDirMotor*>(motor)->position;
+}
+
+void IRAM_ATTR StepDirMotor::stopFromISR(Motor* motor) {
+    // Same as stop() while running: the translator drops the rest
+    StepDirMotor* self = static_cast<StepDirMotor*>(motor);
+    if (self->running) {
+        self->stopRequested = true;
+    }
+}
+
+void StepDirMotor::applyPower(void* arg, uint8_t level) {
+    StepDirMotor* motor = static_cast<StepDirMotor*>(arg);
+    if (motor->enablePin >= 0) {
+        digitalWrite(motor->enablePin, level == 0 ? HIGH : LOW);
+    }
+}
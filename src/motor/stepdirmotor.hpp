@@ -0,0 +1,104 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/rmt.h>
+#include "motor.hpp"
+#include "stepper/StepRamp.h"
+
+/**
+ * @brief Motor driven by a STEP/DIR driver chip
+ *
+ * Step pulses are generated by one RMT channel. A move is queued with a
+ * single rmt_write_sample() call; the RMT driver's translator turns each
+ * step into a pulse item whose low time comes from the acceleration ramp.
+ * The driver fills the channel memory once at the start and refills it from
+ * its interrupt each time half of it has been sent, so the CPU handles one
+ * interrupt per few dozen steps instead of one per step. The end-of-
+ * transmission interrupt completes the move.
+ *
+ * Timing resolution is 1 us (APB clock divided by 80).
+ *
+ * A pill detected during dispense() stops the move from the sensor
+ * interrupt; the pulses already in the channel memory (at most one memory
+ * block of 64 items) still go out, which bounds the overshoot.
+ *
+ * The idle policy toggles the active-low ENABLE input: any hold duty keeps
+ * the driver enabled (drivers reduce standstill current themselves), 0
+ * disables it.
+ */
+class StepDirMotor : public Motor {
+    public:
+        /**
+         * @brief Motor on the default pins MOTOR_STEP_PIN, MOTOR_DIR_PIN and
+         *        MOTOR_ENABLE_PIN using RMT channel 0
+         */
+        StepDirMotor();
+
+        /**
+         * @param stepPin STEP input of the driver
+         * @param dirPin DIR input of the driver
+         * @param enablePin Active-low ENABLE input, or -1 if not connected
+         * @param stepsPerRevolution Full steps times the microstep factor
+         * @param channel RMT channel, one per motor
+         */
+        StepDirMotor(int stepPin, int dirPin, int enablePin, int stepsPerRevolution, rmt_channel_t channel);
+
+        void initialize() override;
+        void setSpeed(double speed) override;
+        void setAcceleration(long acceleration, StepRamp::Profile profile = StepRamp::TRAPEZOID) override;
+        void step(int steps) override;
+        bool moveAsync(int steps) override;
+        bool isRunning() override;
+
+        /**
+         * @brief Stop generating pulses and start the idle timeout
+         *
+         * Pulses already copied into the RMT channel memory (at most one
+         * memory block) are still sent.
+         */
+        void stop() override;
+
+        void setCompletionCallback(CompletionCallback callback, void* arg) override;
+        long getPosition() override;
+        void setPosition(long position) override;
+        long getStepsPerRevolution() override;
+
+    private:
+        static void IRAM_ATTR translate(const void* src, rmt_item32_t* dest, size_t srcSize,
+                                        size_t wantedNum, size_t* translatedSize, size_t* itemNum);
+        static size_t IRAM_ATTR fillSpill(StepDirMotor* motor, rmt_item32_t* dest, size_t wantedNum);
+        static void IRAM_ATTR onTxEnd(rmt_channel_t channel, void* arg);
+
+        static void applyPower(void* arg, uint8_t level);
+        static long IRAM_ATTR positionFromISR(Motor* motor);
+        static void IRAM_ATTR stopFromISR(Motor* motor);
+
+        static StepDirMotor* channelOwners[RMT_CHANNEL_MAX];
+
+        int stepPin;
+        int dirPin;
+        int enablePin;
+        int stepsPerRevolution;
+        rmt_channel_t channel;
+        bool installed = false;
+
+        StepRamp ramp;
+        StepRamp::Profile profile = StepRamp::CONSTANT;
+        long acceleration = 0;
+        unsigned long stepDelay = 0;
+
+        // Move state, shared with the RMT interrupt
+        volatile bool running = false;
+        volatile bool stopRequested = false;
+        int stepsTotal = 0;
+        volatile int stepsDone = 0;
+        uint32_t spill = 0;         // low time of the last step not yet in an item, us
+        int direction = 1;
+
+        // Counted when a step is handed to the RMT, so it runs ahead of the
+        // shaft by the buffered items until the move has finished
+        volatile long position = 0;
+
+        CompletionCallback completionCallback = nullptr;
+        void* completionArg = nullptr;
+};
@@ -1,26 +1,136 @@
-#include "motor.hpp"
-#include <Stepper.h>
+#include "steppermotor.hpp"
+#include "stepper/StepScheduler.h"
+#include <Arduino.h>
+#include <defines.hpp>
 
-#define STEPS 200 
-Stepper stepper(STEPS, 8, 9, 10, 11);
+// Shared time base for all motors, so several compartments can move at once
+static StepScheduler scheduler;
 
-Motor::Motor() {
-    // Constructor implementation (if needed)
+StepperMotor::StepperMotor()
+    : StepperMotor(MOTOR_PIN_1, MOTOR_PIN_2, MOTOR_PIN_3, MOTOR_PIN_4, MOTOR_COIL_ENABLE_PIN) {
 }
 
-void Motor::initialize() {
+StepperMotor::StepperMotor(int pin1, int pin2, int pin3, int pin4, int enablePin)
+    : stepper(MOTOR_STEPS, pin1, pin2, pin3, pin4),
+      enablePin(enablePin) {
+    setIsrAccess(&StepperMotor::positionFromISR, &StepperMotor::stopFromISR);
+}
+
+void StepperMotor::initialize() {
     stepper.setSpeed(30);
+
+    // Register with the scheduler once; moveAsync() is routed through it
+    if (axis < 0) {
+        axis = scheduler.addAxis(&stepper);
+        if (axis < 0) {
+            Serial.println("[Motor] No free scheduler axis, async moves disabled");
+        }
+
+        // One LEDC channel per motor for the reduced-hold PWM
+        if (enablePin >= 0 && axis >= 0) {
+            ledcChannel = MOTOR_HOLD_LEDC_CHANNEL + axis;
+            ledcSetup(ledcChannel, MOTOR_HOLD_PWM_FREQ, 8);
+            ledcAttachPin(enablePin, ledcChannel);
+        }
+    }
+
+    // Coils start released and are energised by the first move
+    stepper.setCompletionCallback(&StepperMotor::onMoveDone, this);
+    idlePolicy.begin(&StepperMotor::applyPower, this);
+    idlePolicy.configure(MOTOR_IDLE_TIMEOUT, MOTOR_HOLD_DUTY);
+    idlePolicy.release();
 }
 
-void Motor::setSpeed(double speed) {
+void StepperMotor::setSpeed(double speed) {
     stepper.setSpeed(speed);
 }
 
-void Motor::step(int steps) {
+void StepperMotor::setAcceleration(long acceleration, StepRamp::Profile profile) {
+    stepper.setProfile(profile);
+    stepper.setAcceleration(acceleration);
+}
+
+void StepperMotor::step(int steps) {
+    idlePolicy.wake();
     stepper.step(steps);
+    idlePolicy.idle();
+}
+
+bool StepperMotor::moveAsync(int steps) {
+    if (axis < 0) {
+        Serial.println("[Motor] Move ignored, motor not initialized");
+        return false;
+    }
+    if (steps == 0) {
+        return false;
+    }
+    idlePolicy.wake();
+    if (!scheduler.move(axis, steps)) {
+        Serial.println("[Motor] Scheduler rejected the move");
+        idlePolicy.idle();
+        return false;
+    }
+    return true;
+}
+
+bool StepperMotor::isRunning() {
+    return stepper.isRunning();
+}
+
+void StepperMotor::stop() {
+    // End a running asynchronous move after the current step; its completion
+    // starts the idle timeout. When already idle, start it from here.
+    if (stepper.isRunning()) {
+        scheduler.stop(axis);
+    } else {
+        idlePolicy.idle();
+    }
+}
+
+void StepperMotor::setCompletionCallback(CompletionCallback callback, void* arg) {
+    completionCallback = callback;
+    completionArg = arg;
+}
+
+long StepperMotor::getPosition() {
+    return stepper.currentPosition();
+}
+
+void StepperMotor::setPosition(long position) {
+    stepper.setCurrentPosition(position);
+}
+
+long StepperMotor::getStepsPerRevolution() {
+    return stepper.stepsPerRevolution();
+}
+
+void StepperMotor::applyPower(void* arg, uint8_t level) {
+    StepperMotor* motor = static_cast<StepperMotor*>(arg);
+
+    if (level == 0) {
+        motor->stepper.release();
+    } else {
+        // Re-apply the last phase; the enable duty sets the current
+        motor->stepper.energize();
+    }
+    if (motor->enablePin >= 0) {
+        ledcWrite(motor->ledcChannel, level);
+    }
+}
+
+long IRAM_ATTR StepperMotor::positionFromISR(Motor* motor) {
+    return static_cast<StepperMotor*>(motor)->stepper.currentPosition();
+}
+
+void IRAM_ATTR StepperMotor::stopFromISR(Motor* motor) {
+    // The scheduler finishes the axis on its next deadline without a step
+    static_cast<StepperMotor*>(motor)->stepper.requestStop();
 }
 
-void Motor::stop() {
-    // Stopping a stepper motor typically involves simply not sending further step commands.
-    // You might want to implement a method to disable the motor if your hardware supports it.
+void IRAM_ATTR StepperMotor::onMoveDone(void* arg) {
+    StepperMotor* motor = static_cast<StepperMotor*>(arg);
+    motor->idlePolicy.idle();
+    if (motor->completionCallback != nullptr) {
+        motor->completionCallback(motor->completionArg);
+    }
 }
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "motor.hpp"
+#include "stepper/Stepper.h"
+
+/**
+ * @brief Motor whose coils are switched directly by the Stepper library
+ *
+ * All StepperMotor instances share one StepScheduler, so moves started with
+ * moveAsync() on different motors run at the same time on a common time base.
+ */
+class StepperMotor : public Motor {
+    public:
+        /**
+         * @brief Motor on the default pins MOTOR_PIN_1..MOTOR_PIN_4
+         */
+        StepperMotor();
+
+        /**
+         * @brief Motor on the given four coil pins
+         * @param enablePin Enable input of the coil driver for reduced-hold
+         *                  PWM, or -1 if not connected
+         */
+        StepperMotor(int pin1, int pin2, int pin3, int pin4, int enablePin = -1);
+
+        void initialize() override;
+        void setSpeed(double speed) override;
+        void setAcceleration(long acceleration, StepRamp::Profile profile = StepRamp::TRAPEZOID) override;
+        void step(int steps) override;
+        bool moveAsync(int steps) override;
+        bool isRunning() override;
+        void stop() override;
+        void setCompletionCallback(CompletionCallback callback, void* arg) override;
+        long getPosition() override;
+        void setPosition(long position) override;
+        long getStepsPerRevolution() override;
+
+    private:
+        static void applyPower(void* arg, uint8_t level);
+        static void onMoveDone(void* arg);
+        static long IRAM_ATTR positionFromISR(Motor* motor);
+        static void IRAM_ATTR stopFromISR(Motor* motor);
+
+        Stepper stepper;
+        int axis = -1;
+        int enablePin;
+        uint8_t ledcChannel = 0;
+
+        CompletionCallback completionCallback = nullptr;
+        void* completionArg = nullptr;
+};
@@ -0,0 +1,176 @@
+#include "bus_frame.hpp"
+
+// Header (type, dst, seq) and trailer (CRC16) around the payload
+#define BUS_HEADER_SIZE 3
+#define BUS_CRC_SIZE 2
+
+static const uint16_t crcNibbles[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t busCrc16(const uint8_t* data, size_t length, uint16_t crc) {
+    for (size_t i = 0; i < length; i++) {
+        crc = (crc << 4) ^ crcNibbles[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ crcNibbles[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+size_t encodeBusFrame(const BusFrame& frame, uint8_t* out, size_t outSize) {
+    if (frame.length > BUS_MAX_PAYLOAD || outSize < BUS_MAX_ENCODED) {
+        return 0;
+    }
+
+    const uint8_t header[BUS_HEADER_SIZE] = {frame.type, frame.dst, frame.seq};
+    uint16_t crc = busCrc16(header, BUS_HEADER_SIZE);
+    crc = busCrc16(frame.payload, frame.length, crc);
+    const uint8_t trailer[BUS_CRC_SIZE] = {(uint8_t)(crc >> 8), (uint8_t)(crc & 0xFF)};
+
+    // COBS: every block starts with the distance to the next zero
+    size_t codeIndex = 0;
+    size_t written = 1;
+    uint8_t code = 1;
+    const size_t payloadEnd = BUS_HEADER_SIZE + (size_t)frame.length;
+    const size_t total = payloadEnd + BUS_CRC_SIZE;
+
+    for (size_t i = 0; i < total; i++) {
+        uint8_t byte;
+        if (i < BUS_HEADER_SIZE) {
+            byte = header[i];
+        } else if (i < payloadEnd) {
+            byte = frame.payload[i - BUS_HEADER_SIZE];
+        } else {
+            byte = trailer[i - payloadEnd];
+        }
+
+        if (byte != 0) {
+            out[written++] = byte;
+            code++;
+        }
+        if (byte == 0 || code == 0xFF) {
+            out[codeIndex] = code;
+            codeIndex = written++;
+            code = 1;
+        }
+    }
+    out[codeIndex] = code;
+    out[written++] = 0x00;
+    return written;
+}
+
+FrameDecoder::FrameDecoder()
+    : length(0),
+      code(0),
+      remaining(0),
+      overflow(false),
+      skipping(false),
+      filtering(false),
+      unicast(BUS_ADDR_BROADCAST),
+      groups(0),
+      decoded{0, 0, 0, 0, nullptr},
+      frameCount(0),
+      errorCount(0),
+      skippedCount(0) {
+}
+
+void FrameDecoder::reset() {
+    length = 0;
+    code = 0;
+    remaining = 0;
+    overflow = false;
+    skipping = false;
+}
+
+void FrameDecoder::setAddress(uint8_t unicast, uint8_t groups) {
+    this->unicast = unicast;
+    this->groups = groups;
+    filtering = true;
+}
+
+void FrameDecoder::acceptAll() {
+    filtering = false;
+}
+
+void FrameDecoder::checkAddress() {
+    if (!filtering || length != 2) {
+        return;
+    }
+    const uint8_t type = buffer[0];
+    const uint8_t dst = buffer[1];
+    if (type & BUS_FRAME_MULTICAST) {
+        skipping = (dst & groups) == 0;
+    } else {
+        skipping = dst != BUS_ADDR_BROADCAST && dst != unicast;
+    }
+}
+
+FrameDecoder::Result FrameDecoder::push(uint8_t byte) {
+    if (byte == 0x00) {
+        return finish();
+    }
+    if (overflow || skipping) {
+        return NONE;
+    }
+
+    if (remaining == 0) {
+        // Start of a new block; the previous one ended in a zero unless it
+        // was a full 254-byte block or this is the first block
+        if (code != 0 && code != 0xFF) {
+            if (length >= sizeof(buffer)) {
+                overflow = true;
+                return NONE;
+            }
+            buffer[length++] = 0x00;
+            checkAddress();
+        }
+        code = byte;
+        remaining = byte - 1;
+        return NONE;
+    }
+
+    if (length >= sizeof(buffer)) {
+        overflow = true;
+        return NONE;
+    }
+    buffer[length++] = byte;
+    remaining--;
+    checkAddress();
+    return NONE;
+}
+
+FrameDecoder::Result FrameDecoder::finish() {
+    if (skipping) {
+        reset();
+        skippedCount++;
+        return NONE;
+    }
+    const bool empty = code == 0 && length == 0 && !overflow;
+    const bool valid = !overflow && remaining == 0 && length >= BUS_HEADER_SIZE + BUS_CRC_SIZE;
+    const size_t frameLength = length;
+    reset();
+
+    // Back-to-back delimiters are idle line, not errors
+    if (empty) {
+        return NONE;
+    }
+    if (!valid) {
+        errorCount++;
+        return ERROR;
+    }
+
+    const size_t payloadLength = frameLength - BUS_HEADER_SIZE - BUS_CRC_SIZE;
+    const uint16_t expected = ((uint16_t)buffer[frameLength - 2] << 8) | buffer[frameLength - 1];
+    if (busCrc16(buffer, frameLength - BUS_CRC_SIZE) != expected) {
+        errorCount++;
+        return ERROR;
+    }
+
+    decoded.type = buffer[0];
+    decoded.dst = buffer[1];
+    decoded.seq = buffer[2];
+    decoded.length = (uint8_t)payloadLength;
+    decoded.payload = buffer + BUS_HEADER_SIZE;
+    frameCount++;
+    return FRAME;
+}
@@ -0,0 +1,154 @@
+#ifndef BUS_FRAME_HPP
+#define BUS_FRAME_HPP
+
+#include <Arduino.h>
+#include "defines.hpp"
+
+/**
+ * @brief Frame types on the inter-MedBox UART bus
+ */
+enum BusFrameType : uint8_t {
+    FRAME_ENUM_START = 0x01,  ///< Master: slaves reset their address and wait; enumeration rate (u32 LE)
+    FRAME_ENUM_REPLY = 0x02,  ///< Slave: 6-byte MAC after its SERIAL_IN pulse
+    FRAME_ENUM_ACK   = 0x03,  ///< Master: MAC + assigned address
+    FRAME_ENUM_DONE  = 0x04,  ///< Master: enumeration or topology check finished; 1 = registry full
+    FRAME_ENUM_FROM  = 0x05,  ///< Master: re-enumerate from the address in the payload, then the rate (u32 LE)
+    FRAME_TOPO_START = 0x06,  ///< Master: enumerated slaves report on their next pulse
+    FRAME_TOPO_REPLY = 0x07,  ///< Slave: sender address, chain hash (u32 LE)
+    FRAME_DATA       = 0x10,  ///< Application payload
+    FRAME_DATA_SEQ   = 0x11,  ///< Master: payload in the slave's sequence space
+    FRAME_DATA_ACK   = 0x12,  ///< Slave: sender, next expected seq, SACK (u32 LE)
+    FRAME_DATA_SYNC  = 0x13,  ///< Master: restart the slave's sequence space at seq, epoch
+
+    FRAME_BAUD_PROBE  = 0x20, ///< Master: try the rate in the payload (u32 LE)
+    FRAME_BAUD_TEST   = 0x21, ///< Master: test pattern at the probed rate
+    FRAME_BAUD_QUERY  = 0x22, ///< Master: ask one slave for its test result
+    FRAME_BAUD_REPORT = 0x23, ///< Slave: sender address, good test frames
+    FRAME_BAUD_COMMIT = 0x24, ///< Master: keep the probed rate
+    FRAME_BAUD_SET    = 0x25, ///< Master: switch to the rate in the payload now
+
+    FRAME_BARRIER_ARM = 0x30, ///< Master: hold PARALLEL_PIN low until ready
+
+    FRAME_ATTN_SELECT = 0x31, ///< Master: only flagged slaves in [lo, hi] hold PARALLEL_PIN
+    FRAME_ATTN_POLL   = 0x32, ///< Master: ask one flagged slave for its reasons
+    FRAME_ATTN_REPORT = 0x33, ///< Slave: sender address, attention reasons
+    FRAME_ATTN_CLEAR  = 0x34, ///< Master: reasons handled, stop holding for them
+
+    FRAME_STATUS_QUERY  = 0x40, ///< Master: report status; broadcast carries the slot length in us (u16 LE)
+    FRAME_STATUS_REPORT = 0x41, ///< Slave: sender address, up to BUS_STATUS_SIZE status bytes
+
+    FRAME_GROUP_SET   = 0x50, ///< Master: groups of the slave (mask)
+    FRAME_GROUP_ACK   = 0x51  ///< Slave: sender address, groups now in effect
+};
+
+/**
+ * @brief One decoded bus frame
+ * 
+ * A view: payload points into the buffer of the encoder caller or the
+ * FrameDecoder and is only valid until that buffer changes.
+ */
+struct BusFrame {
+    uint8_t type;
+    uint8_t dst;
+    uint8_t seq;
+    uint8_t length;
+    const uint8_t* payload;
+};
+
+/**
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+ */
+uint16_t busCrc16(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+
+/**
+ * @brief Encode a frame for the wire
+ * 
+ * Layout before stuffing: type, dst, seq, payload, CRC16 (big endian over
+ * everything before it). The result is COBS encoded and ends with the 0x00
+ * delimiter, so a receiver can resynchronise on any zero byte.
+ * 
+ * @param frame Frame to encode, length at most BUS_MAX_PAYLOAD
+ * @param out Output buffer, BUS_MAX_ENCODED bytes are always enough
+ * @return Bytes written, 0 if the frame does not fit
+ */
+size_t encodeBusFrame(const BusFrame& frame, uint8_t* out, size_t outSize);
+
+/**
+ * @brief Incremental, allocation-free bus frame decoder
+ * 
+ * Fed one byte at a time straight from the UART. Undoes the COBS stuffing
+ * in place into a fixed buffer and checks length and CRC when the
+ * delimiter arrives. Garbage, truncated or oversized frames are counted
+ * and dropped; decoding restarts at the next delimiter.
+ * 
+ * With an address set, frames for other nodes are skipped as soon as their
+ * type and dst have arrived: no buffering, no CRC, no frame handler.
+ */
+class FrameDecoder {
+public:
+    enum Result {
+        NONE,    ///< Frame not complete yet
+        FRAME,   ///< frame() holds a valid frame
+        ERROR    ///< A corrupt frame was dropped
+    };
+
+    FrameDecoder();
+
+    /**
+     * @brief Feed one received byte
+     */
+    Result push(uint8_t byte);
+
+    /**
+     * @brief Last valid frame, valid until the next push()
+     */
+    const BusFrame& frame() const { return decoded; }
+
+    /**
+     * @brief Discard a partially received frame
+     */
+    void reset();
+
+    /**
+     * @brief Only pass frames addressed to this node
+     * 
+     * Passed are frames to BUS_ADDR_BROADCAST or to unicast, and multicast
+     * frames whose group mask shares a bit with groups.
+     */
+    void setAddress(uint8_t unicast, uint8_t groups);
+
+    /**
+     * @brief Pass every frame (default, used by the master)
+     */
+    void acceptAll();
+
+    uint32_t getFrameCount() const { return frameCount; }
+    uint32_t getErrorCount() const { return errorCount; }
+    uint32_t getSkippedCount() const { return skippedCount; }
+
+private:
+    Result finish();
+
+    /**
+     * @brief Start skipping once type and dst show the frame is not ours
+     */
+    void checkAddress();
+
+    uint8_t buffer[BUS_MAX_RAW];
+    size_t length;
+    uint8_t code;       // code byte of the current COBS block
+    uint8_t remaining;  // data bytes left in the current block
+    bool overflow;      // frame too long, drop it at the delimiter
+    bool skipping;      // frame for another node, drop it at the delimiter
+
+    bool filtering;
+    uint8_t unicast;
+    uint8_t groups;
+
+    BusFrame decoded;
+    uint32_t frameCount;
+    uint32_t errorCount;
+    uint32_t skippedCount;
+};
+
+#endif // BUS_FRAME_HPP
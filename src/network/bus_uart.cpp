@@ -0,0 +1,183 @@
+#include "bus_uart.hpp"
+
+BusUart::BusUart(uart_port_t port)
+    : port(port),
+      installed(false),
+      baudRate(0),
+      events(nullptr),
+      task(nullptr),
+      handler(nullptr),
+      tickHandler(nullptr),
+      tickPeriod(0),
+      lastTick(0) {
+}
+
+void BusUart::setTickHandler(TickHandler handler, uint32_t periodMs) {
+    tickHandler = handler;
+    tickPeriod = periodMs;
+}
+
+void BusUart::tick() {
+    if (tickHandler != nullptr && millis() - lastTick >= tickPeriod) {
+        lastTick = millis();
+        tickHandler();
+    }
+}
+
+bool BusUart::begin(unsigned long baud, int rxPin, int txPin, FrameHandler handler) {
+    this->handler = handler;
+
+    if (!installed) {
+        uart_config_t config = {};
+        config.baud_rate = (int)baud;
+        config.data_bits = UART_DATA_8_BITS;
+        config.parity = UART_PARITY_DISABLE;
+        config.stop_bits = UART_STOP_BITS_1;
+        config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+        config.source_clk = UART_SCLK_APB;
+
+        if (uart_driver_install(port, BUS_RX_BUFFER_SIZE, 0, BUS_EVENT_QUEUE_SIZE, &events, 0) != ESP_OK) {
+            Serial.println("[BusUart] UART driver install failed");
+            return false;
+        }
+        uart_param_config(port, &config);
+        uart_set_pin(port, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+        installed = true;
+        baudRate = baud;
+    }
+
+    // Raise an event on every frame delimiter, also in the middle of a burst
+    const bool patternReady =
+        uart_enable_pattern_det_baud_intr(port, 0x00, 1, 1, 0, 0) == ESP_OK &&
+        uart_pattern_queue_reset(port, BUS_EVENT_QUEUE_SIZE) == ESP_OK;
+
+    if (patternReady && task == nullptr) {
+        BaseType_t created = xTaskCreatePinnedToCore(
+            taskEntry,          // Task function
+            "busRx",            // Task name (for debugging)
+            4096,               // Stack size in bytes
+            this,               // Task parameter
+            BUS_RX_TASK_PRIORITY,
+            &task,              // Task handle
+            BUS_RX_TASK_CORE    // Core ID (0 or 1)
+        );
+        if (created != pdPASS) {
+            task = nullptr;
+        }
+    }
+
+    if (task == nullptr) {
+        Serial.println("[BusUart] Receive task unavailable, falling back to polling");
+    } else {
+        Serial.printf("[BusUart] Event-driven receive on core %d\n", BUS_RX_TASK_CORE);
+    }
+    return true;
+}
+
+bool BusUart::setBaudRate(unsigned long baud) {
+    if (!installed) {
+        return false;
+    }
+    uart_wait_tx_done(port, pdMS_TO_TICKS(100));
+    if (uart_set_baudrate(port, (uint32_t)baud) != ESP_OK) {
+        return false;
+    }
+    uart_flush_input(port);
+    decoder.reset();
+    baudRate = baud;
+    return true;
+}
+
+void BusUart::poll() {
+    if (installed && task == nullptr) {
+        drain();
+        tick();
+    }
+}
+
+bool BusUart::write(const BusFrame& frame) {
+    uint8_t encoded[BUS_MAX_ENCODED];
+    const size_t size = encodeBusFrame(frame, encoded, sizeof(encoded));
+    if (!installed || size == 0) {
+        return false;
+    }
+    // One call per frame; the driver serialises concurrent writers
+    uart_write_bytes(port, (const char*)encoded, size);
+    return true;
+}
+
+void BusUart::writeDelimiter() {
+    const char delimiter = 0x00;
+    if (installed) {
+        uart_write_bytes(port, &delimiter, 1);
+    }
+}
+
+void BusUart::waitTxDone() {
+    if (installed) {
+        uart_wait_tx_done(port, pdMS_TO_TICKS(100));
+    }
+}
+
+void BusUart::taskEntry(void* param) {
+    static_cast<BusUart*>(param)->run();
+}
+
+void BusUart::run() {
+    uart_event_t event;
+    const TickType_t wait = tickHandler != nullptr ? max((TickType_t)1, pdMS_TO_TICKS(tickPeriod)) : portMAX_DELAY;
+    for (;;) {
+        const bool received = xQueueReceive(events, &event, wait) == pdTRUE;
+        tick();
+        if (!received) {
+            continue;
+        }
+
+        switch (event.type) {
+            case UART_DATA:
+            case UART_PATTERN_DET:
+                // The pattern positions are not needed, the decoder finds
+                // the delimiters itself; keep the position queue empty
+                while (uart_pattern_pop_pos(port) >= 0) {
+                }
+                drain();
+                break;
+
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                // Bytes were lost, the current frame cannot be trusted
+                Serial.println("[BusUart] RX overflow, flushing");
+                uart_flush_input(port);
+                uart_pattern_queue_reset(port, BUS_EVENT_QUEUE_SIZE);
+                xQueueReset(events);
+                decoder.reset();
+                break;
+
+            case UART_FRAME_ERR:
+            case UART_PARITY_ERR:
+            case UART_BREAK:
+            default:
+                break;
+        }
+    }
+}
+
+void BusUart::drain() {
+    uint8_t chunk[64];
+    size_t buffered = 0;
+
+    while (uart_get_buffered_data_len(port, &buffered) == ESP_OK && buffered > 0) {
+        const int count = uart_read_bytes(port, chunk, min(buffered, sizeof(chunk)), 0);
+        if (count <= 0) {
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            FrameDecoder::Result result = decoder.push(chunk[i]);
+            if (result == FrameDecoder::FRAME && handler != nullptr) {
+                handler(decoder.frame());
+            } else if (result == FrameDecoder::ERROR) {
+                Serial.printf("[BusUart] Dropped corrupt frame (%u total)\n", (unsigned)decoder.getErrorCount());
+            }
+        }
+    }
+}
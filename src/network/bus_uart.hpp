@@ -0,0 +1,128 @@
+#ifndef BUS_UART_HPP
+#define BUS_UART_HPP
+
+#include <Arduino.h>
+#include <functional>
+#include <driver/uart.h>
+#include "defines.hpp"
+#include "bus_frame.hpp"
+
+/**
+ * @brief Event-driven UART transport for bus frames
+ * 
+ * Owns the ESP-IDF UART driver of the inter-MedBox bus. A receive task
+ * blocks on the driver event queue; pattern detection on the 0x00 frame
+ * delimiter raises an event as soon as a frame has ended, so frames are
+ * decoded and handed to the frame handler within microseconds instead of
+ * waiting for the next loop() pass or the RX idle timeout.
+ * 
+ * If the receive task cannot be started, poll() decodes buffered bytes
+ * from the caller's context instead (polling fallback).
+ */
+class BusUart {
+public:
+    /**
+     * @brief Called for every valid frame, from the receive task
+     * (or from poll() in fallback mode)
+     */
+    using FrameHandler = std::function<void(const BusFrame& frame)>;
+
+    /**
+     * @brief Called periodically from the receive task (or poll())
+     */
+    using TickHandler = std::function<void()>;
+
+    explicit BusUart(uart_port_t port);
+
+    /**
+     * @brief Install the UART driver and start the receive task
+     * @param baud Initial baud rate
+     * @param rxPin Receive pin
+     * @param txPin Transmit pin
+     * @param handler Frame handler
+     * @return false if the driver could not be installed
+     */
+    bool begin(unsigned long baud, int rxPin, int txPin, FrameHandler handler);
+
+    /**
+     * @brief Run a handler every periodMs between frames
+     * 
+     * Keeps protocol timers on the receive task instead of loop(). Set it
+     * before begin().
+     */
+    void setTickHandler(TickHandler handler, uint32_t periodMs);
+
+    /**
+     * @brief Decode buffered bytes when running without receive task
+     * 
+     * Does nothing while the receive task is active.
+     */
+    void poll();
+
+    /**
+     * @brief Encode and transmit one frame
+     * @return false if the frame is too long or the driver is not installed
+     */
+    bool write(const BusFrame& frame);
+
+    /**
+     * @brief Transmit a lone delimiter so receivers drop partial frames
+     */
+    void writeDelimiter();
+
+    /**
+     * @brief Block until all queued bytes have left the transmitter
+     */
+    void waitTxDone();
+
+    /**
+     * @brief Change the baud rate once pending output has been sent
+     * 
+     * Received bytes still buffered at the old rate are discarded.
+     */
+    bool setBaudRate(unsigned long baud);
+
+    /**
+     * @brief Drop frames for other nodes in the decoder (slaves)
+     * 
+     * See FrameDecoder::setAddress(); the frame handler never sees them.
+     */
+    void setAddressFilter(uint8_t unicast, uint8_t groups) { decoder.setAddress(unicast, groups); }
+
+    unsigned long getBaudRate() const { return baudRate; }
+
+    /**
+     * @brief true while frames are received by the event-driven task
+     */
+    bool isEventDriven() const { return task != nullptr; }
+
+    uint32_t getFrameCount() const { return decoder.getFrameCount(); }
+    uint32_t getErrorCount() const { return decoder.getErrorCount(); }
+
+private:
+    static void taskEntry(void* param);
+    void run();
+
+    /**
+     * @brief Read everything buffered by the driver and decode it
+     */
+    void drain();
+
+    /**
+     * @brief Call the tick handler if its period has passed
+     */
+    void tick();
+
+    uart_port_t port;
+    bool installed;
+    unsigned long baudRate;
+    QueueHandle_t events;
+    TaskHandle_t task;
+    FrameHandler handler;
+    TickHandler tickHandler;
+    uint32_t tickPeriod;
+    unsigned long lastTick;
+    FrameDecoder decoder;
+};
+
+#endif // BUS_UART_HPP
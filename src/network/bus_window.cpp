@@ -0,0 +1,239 @@
+#include "bus_window.hpp"
+
+// Signed distance between two sequence numbers, valid within half the space
+static inline int8_t seqDiff(uint8_t a, uint8_t b) {
+    return (int8_t)(uint8_t)(a - b);
+}
+
+// ============================================================================
+// SendWindow
+// ============================================================================
+
+SendWindow::SendWindow()
+    : transmitter(nullptr),
+      dropHandler(nullptr) {
+    for (int i = 0; i < MAX_SLAVES; i++) {
+        streams[i].epoch = 0;
+    }
+    reset();
+}
+
+void SendWindow::begin(Transmit transmit, DropHandler dropHandler, uint8_t epoch) {
+    this->transmitter = transmit;
+    this->dropHandler = dropHandler;
+    for (int i = 0; i < MAX_SLAVES; i++) {
+        streams[i].epoch = epoch;
+    }
+}
+
+void SendWindow::reset(uint8_t first) {
+    if (first == 0) {
+        used = 0;
+    }
+    for (int i = 0; i < BUS_SEND_SLOTS; i++) {
+        if (first == 0) {
+            slots[i].state = SLOT_FREE;
+        } else if (slots[i].state != SLOT_FREE && slots[i].dst >= first) {
+            release(slots[i]);
+        }
+    }
+    for (int i = first; i < MAX_SLAVES; i++) {
+        streams[i].nextSeq = 0;
+        streams[i].base = 0;
+        streams[i].needSync = true;
+    }
+}
+
+SendWindow::Slot* SendWindow::allocate(uint8_t type, uint8_t dst, const uint8_t* payload, uint8_t length) {
+    for (int i = 0; i < BUS_SEND_SLOTS; i++) {
+        Slot& slot = slots[i];
+        if (slot.state != SLOT_FREE) {
+            continue;
+        }
+        slot.state = SLOT_QUEUED;
+        slot.type = type;
+        slot.dst = dst;
+        slot.seq = streams[dst].nextSeq++;
+        slot.length = length;
+        slot.retries = 0;
+        slot.resent = false;
+        if (length > 0) {
+            memcpy(slot.payload, payload, length);
+        }
+        used++;
+        return &slot;
+    }
+    return nullptr;
+}
+
+void SendWindow::release(Slot& slot) {
+    slot.state = SLOT_FREE;
+    used--;
+}
+
+bool SendWindow::send(uint8_t dst, const uint8_t* payload, uint8_t length) {
+    if (dst >= MAX_SLAVES || length > BUS_MAX_PAYLOAD) {
+        return false;
+    }
+    Stream& stream = streams[dst];
+    const uint8_t needed = stream.needSync ? 2 : 1;
+    if (BUS_SEND_SLOTS - used < needed) {
+        return false;
+    }
+
+    // The SYNC takes the first sequence number of the restarted stream.
+    // Epochs keep counting across reset() so a slave never mistakes the
+    // new SYNC for a resend of its current one.
+    if (stream.needSync) {
+        stream.base = stream.nextSeq;
+        stream.epoch++;
+        allocate(FRAME_DATA_SYNC, dst, &stream.epoch, 1);
+        stream.needSync = false;
+    }
+    allocate(FRAME_DATA_SEQ, dst, payload, length);
+    pump(millis());
+    return true;
+}
+
+void SendWindow::transmit(Slot& slot, unsigned long now) {
+    slot.state = SLOT_SENT;
+    slot.sentAt = now;
+    if (transmitter != nullptr) {
+        transmitter(slot.type, slot.dst, slot.seq, slot.payload, slot.length);
+    }
+}
+
+void SendWindow::pump(unsigned long now) {
+    for (int i = 0; i < BUS_SEND_SLOTS; i++) {
+        Slot& slot = slots[i];
+        if (slot.state == SLOT_QUEUED &&
+            (uint8_t)(slot.seq - streams[slot.dst].base) < BUS_SEND_WINDOW) {
+            transmit(slot, now);
+        }
+    }
+}
+
+void SendWindow::acknowledge(uint8_t src, uint8_t next, uint32_t sack) {
+    if (src >= MAX_SLAVES) {
+        return;
+    }
+    Stream& stream = streams[src];
+
+    // Ignore stale ACKs from before a resync
+    if (seqDiff(next, stream.base) < 0 || seqDiff(next, stream.nextSeq) > 0) {
+        return;
+    }
+    stream.base = next;
+
+    const unsigned long now = millis();
+    for (int i = 0; i < BUS_SEND_SLOTS; i++) {
+        Slot& slot = slots[i];
+        if (slot.state != SLOT_SENT || slot.dst != src) {
+            continue;
+        }
+        const int8_t offset = seqDiff(slot.seq, next);
+        if (offset < 0 || (offset > 0 && offset <= 32 && (sack >> (offset - 1)) & 1)) {
+            release(slot);
+        } else if (offset < 32 && (sack >> offset) != 0 && !slot.resent) {
+            // A later frame arrived, so this one was lost
+            slot.resent = true;
+            transmit(slot, now);
+        }
+    }
+    pump(now);
+}
+
+void SendWindow::poll(unsigned long now) {
+    for (int i = 0; i < BUS_SEND_SLOTS; i++) {
+        Slot& slot = slots[i];
+        if (slot.state != SLOT_SENT || now - slot.sentAt < BUS_RETRANSMIT_TIMEOUT) {
+            continue;
+        }
+        if (slot.retries >= BUS_MAX_RETRIES) {
+            giveUp(slot.dst);
+            continue;
+        }
+        slot.retries++;
+        transmit(slot, now);
+    }
+    pump(now);
+}
+
+void SendWindow::giveUp(uint8_t dst) {
+    uint8_t dropped = 0;
+    for (int i = 0; i < BUS_SEND_SLOTS; i++) {
+        if (slots[i].state != SLOT_FREE && slots[i].dst == dst) {
+            if (slots[i].type == FRAME_DATA_SEQ) {
+                dropped++;
+            }
+            release(slots[i]);
+        }
+    }
+    Stream& stream = streams[dst];
+    stream.base = stream.nextSeq;
+    stream.needSync = true;
+    if (dropHandler != nullptr) {
+        dropHandler(dst, dropped);
+    }
+}
+
+// ============================================================================
+// ReceiveWindow
+// ============================================================================
+
+ReceiveWindow::ReceiveWindow() {
+    reset();
+}
+
+void ReceiveWindow::reset() {
+    synced = false;
+    syncEpoch = 0;
+    syncSeq = 0;
+    expected = 0;
+    held = 0;
+}
+
+bool ReceiveWindow::receive(const BusFrame& frame, const Deliver& deliver) {
+    if (frame.type == FRAME_DATA_SYNC) {
+        // A resent SYNC of the current stream must not rewind it; any other
+        // restarts the stream, even behind expected after a master reset
+        const uint8_t epoch = frame.length == 1 ? frame.payload[0] : 0;
+        if (!synced || epoch != syncEpoch || frame.seq != syncSeq) {
+            synced = true;
+            syncEpoch = epoch;
+            syncSeq = frame.seq;
+            expected = frame.seq + 1;
+            held = 0;
+        }
+        return true;
+    }
+    const int8_t offset = seqDiff(frame.seq, expected);
+    if (frame.type != FRAME_DATA_SEQ || !synced) {
+        return false;
+    }
+
+    // Duplicate or beyond the window: just acknowledge again
+    if (offset < 0 || offset >= BUS_SEND_WINDOW) {
+        return true;
+    }
+    if (offset > 0) {
+        const uint8_t index = frame.seq & (BUS_SEND_WINDOW - 1);
+        lengths[index] = frame.length;
+        memcpy(payloads[index], frame.payload, frame.length);
+        held |= 1UL << (offset - 1);
+        return true;
+    }
+
+    deliver(frame.payload, frame.length);
+    expected++;
+    bool next = held & 1;
+    held >>= 1;
+    while (next) {
+        const uint8_t index = expected & (BUS_SEND_WINDOW - 1);
+        deliver(payloads[index], lengths[index]);
+        expected++;
+        next = held & 1;
+        held >>= 1;
+    }
+    return true;
+}
@@ -0,0 +1,167 @@
+#ifndef BUS_WINDOW_HPP
+#define BUS_WINDOW_HPP
+
+#include <Arduino.h>
+#include <functional>
+#include "defines.hpp"
+#include "bus_frame.hpp"
+
+static_assert(BUS_SEND_WINDOW > 0 && BUS_SEND_WINDOW <= 32 &&
+              (BUS_SEND_WINDOW & (BUS_SEND_WINDOW - 1)) == 0,
+              "BUS_SEND_WINDOW must be a power of two up to 32");
+
+/**
+ * @brief Master side of the sliding-window delivery to slaves
+ * 
+ * Every slave has its own 8-bit sequence space. Up to BUS_SEND_WINDOW
+ * frames per slave are in flight at once, so frames to many slaves are
+ * streamed back to back instead of waiting a round trip each. Frames wait
+ * in a shared pool of BUS_SEND_SLOTS until their slave's window opens.
+ * 
+ * Slaves acknowledge with the next sequence number they expect plus a
+ * bitmap of the frames after it they already hold (selective ACK). A gap
+ * below a selectively acknowledged frame is resent at once, everything
+ * else after BUS_RETRANSMIT_TIMEOUT ms. After BUS_MAX_RETRIES the slave's
+ * queue is dropped and its stream restarted with FRAME_DATA_SYNC, which
+ * also opens every stream after a master reset.
+ * 
+ * A SYNC carries a one-byte epoch that changes with every restart of the
+ * stream. Slaves take any SYNC as a restart except a resent copy of the one
+ * that opened their current stream, so the epoch seed passed to begin()
+ * has to differ between master boots. Should it still match a slave's old
+ * stream, the stale ACKs run the stream into giveUp() and the next SYNC
+ * carries a fresh epoch.
+ * 
+ * Not thread-safe; CommunicationHelper calls it under its lock.
+ */
+class SendWindow {
+public:
+    /**
+     * @brief Puts one frame on the bus
+     */
+    using Transmit = std::function<void(uint8_t type, uint8_t dst, uint8_t seq,
+                                        const uint8_t* payload, uint8_t length)>;
+
+    /**
+     * @brief Called after giving up on a slave, with the frames dropped
+     */
+    using DropHandler = std::function<void(uint8_t dst, uint8_t dropped)>;
+
+    SendWindow();
+
+    /**
+     * @param epoch Seed for the SYNC epochs, e.g. a random number
+     */
+    void begin(Transmit transmit, DropHandler dropHandler, uint8_t epoch);
+
+    /**
+     * @brief Drop queued frames and resynchronise slaves first and up
+     * 
+     * Slaves below first keep their streams, e.g. across a re-enumeration
+     * of the rest of the chain.
+     */
+    void reset(uint8_t first = 0);
+
+    /**
+     * @brief Queue a frame and send it if the slave's window is open
+     * @return false if dst is no slave address or the pool is full
+     */
+    bool send(uint8_t dst, const uint8_t* payload, uint8_t length);
+
+    /**
+     * @brief Process a FRAME_DATA_ACK
+     * @param next Next sequence number the slave expects
+     * @param sack Bit i set: next + 1 + i was received
+     */
+    void acknowledge(uint8_t src, uint8_t next, uint32_t sack);
+
+    /**
+     * @brief Run the retransmission timers
+     */
+    void poll(unsigned long now);
+
+    /**
+     * @brief Frames queued or unacknowledged
+     */
+    uint8_t pending() const { return used; }
+
+private:
+    enum SlotState : uint8_t {
+        SLOT_FREE,
+        SLOT_QUEUED,
+        SLOT_SENT
+    };
+
+    struct Slot {
+        uint8_t state;
+        uint8_t type;
+        uint8_t dst;
+        uint8_t seq;
+        uint8_t length;
+        uint8_t retries;
+        bool resent;              // already resent for a reported gap
+        unsigned long sentAt;
+        uint8_t payload[BUS_MAX_PAYLOAD];
+    };
+
+    struct Stream {
+        uint8_t nextSeq;          // sequence number of the next new frame
+        uint8_t base;             // oldest unacknowledged sequence number
+        bool needSync;            // next frame must be preceded by a SYNC
+        uint8_t epoch;            // epoch of the last SYNC
+    };
+
+    Slot* allocate(uint8_t type, uint8_t dst, const uint8_t* payload, uint8_t length);
+    void release(Slot& slot);
+    void transmit(Slot& slot, unsigned long now);
+    void pump(unsigned long now);
+    void giveUp(uint8_t dst);
+
+    Transmit transmitter;
+    DropHandler dropHandler;
+    Slot slots[BUS_SEND_SLOTS];
+    Stream streams[MAX_SLAVES];
+    uint8_t used;
+};
+
+/**
+ * @brief Slave side of the sliding-window delivery
+ * 
+ * Delivers FRAME_DATA_SEQ payloads exactly once and in order; frames that
+ * arrive ahead of a gap are held until it is filled.
+ */
+class ReceiveWindow {
+public:
+    using Deliver = std::function<void(const uint8_t* payload, uint8_t length)>;
+
+    ReceiveWindow();
+
+    /**
+     * @brief Forget the stream until the next FRAME_DATA_SYNC
+     */
+    void reset();
+
+    /**
+     * @brief Process a FRAME_DATA_SEQ or FRAME_DATA_SYNC addressed to us
+     * 
+     * A SYNC always restarts the stream at its seq, unless it repeats the
+     * epoch and seq of the SYNC that opened the current one.
+     * 
+     * @return true if the frame should be acknowledged
+     */
+    bool receive(const BusFrame& frame, const Deliver& deliver);
+
+    uint8_t getNext() const { return expected; }
+    uint32_t getSack() const { return held; }
+
+private:
+    bool synced;
+    uint8_t syncEpoch;            // epoch and seq of the SYNC that opened the stream
+    uint8_t syncSeq;
+    uint8_t expected;
+    uint32_t held;                // bit i: expected + 1 + i is buffered
+    uint8_t lengths[BUS_SEND_WINDOW];
+    uint8_t payloads[BUS_SEND_WINDOW][BUS_MAX_PAYLOAD];
+};
+
+#endif // BUS_WINDOW_HPP
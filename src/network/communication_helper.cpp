@@ -3,18 +3,48 @@
 #include "defines.hpp"
 #include <WiFi.h>
 #include <driver/uart.h>
+#include <esp_timer.h>
+#include <hal/cpu_hal.h>
 #include <ArduinoJson.h>
 
 // Static instance pointer for ISR
 CommunicationHelper* CommunicationHelper::instance = nullptr;
 
+// Candidate rates for negotiation, ascending
+static const unsigned long baudRates[] = BUS_BAUD_RATES;
+static const int baudRateCount = sizeof(baudRates) / sizeof(baudRates[0]);
+
+static void writeU32(uint8_t* out, uint32_t value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    out[2] = (value >> 16) & 0xFF;
+    out[3] = (value >> 24) & 0xFF;
+}
+
+static uint32_t readU32(const uint8_t* in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+/**
+ * @brief Test frame n: byte 0 holds n, the rest mixes 0x00, 0xFF and
+ *        alternating bit patterns that stress sampling at high rates
+ */
+static void fillTestPattern(uint8_t* out, uint8_t n) {
+    static const uint8_t edges[4] = {0x00, 0xFF, 0x55, 0xAA};
+    out[0] = n;
+    for (int i = 1; i < BUS_BAUD_TEST_SIZE; i++) {
+        out[i] = (i & 4) ? edges[i & 3] : (uint8_t)((i + n) * 0x3B);
+    }
+}
+
 CommunicationHelper::CommunicationHelper() 
-    : uart(2), // Use Serial2 (UART2) for inter-MedBox communication
+    : bus(UART_NUM_2), // UART2 (formerly Serial2) for inter-MedBox communication
+      lock(nullptr),
       uartCallback(nullptr),
       serialInputCallback(nullptr),
-      uartBuffer(""),
-      serialInputChanged(false),
-      serialInputState(LOW) {
+      serialTokenCallback(nullptr),
+      address(BUS_ADDR_UNASSIGNED),
+      txSeq(0) {
 }
 
 void CommunicationHelper::begin(bool isMaster) {
@@ -25,137 +55,680 @@ void CommunicationHelper::begin(bool isMaster) {
         Serial.println("[CommHelper] Warning: Multiple CommunicationHelper instances detected!");
     }
     this->isMaster = isMaster;
+    this->address = isMaster ? BUS_ADDR_MASTER : BUS_ADDR_UNASSIGNED;
+    if (lock == nullptr) {
+        lock = xSemaphoreCreateRecursiveMutex();
+    }
+    if (replies == nullptr) {
+        replies = xQueueCreate(4, sizeof(BusReply));
+    }
+    baudLimit = baudRateCount - 1;
+
+    BusUart::FrameHandler frameHandler = [this](const BusFrame& frame) {
+        xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+        handleFrame(frame);
+        xSemaphoreGiveRecursive(lock);
+    };
+
     if (isMaster) {
-        enumerationUartHandler = std::bind(&CommunicationHelper::enumerationUartMasterHandler, this, std::placeholders::_1);
-        uart.begin(9600, SERIAL_8N1, RX_PIN, TX_PIN);
+        sendWindow.begin(
+            [this](uint8_t type, uint8_t dst, uint8_t seq, const uint8_t* payload, uint8_t length) {
+                sendFrame(type, dst, seq, payload, length);
+            },
+            [this](uint8_t dst, uint8_t dropped) {
+                SlaveEntry* slave = slaves.get(dst);
+                if (slave != nullptr) {
+                    slave->flags &= ~SLAVE_ONLINE;
+                }
+                Serial.printf("[CommHelper] Slave %u not acknowledging, %u message(s) dropped\n", dst, dropped);
+                topologyCheckPending = true;
+            },
+            (uint8_t)esp_random());
+
+        // Retransmission timers run on the receive task
+        bus.setTickHandler([this]() {
+            xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+            sendWindow.poll(millis());
+            xSemaphoreGiveRecursive(lock);
+        }, BUS_RETRANSMIT_TIMEOUT / 4);
+
+        bus.begin(BUS_BASE_BAUD, RX_PIN, TX_PIN, frameHandler);
         // Use pull-down on RX pin (idle state is now LOW with inversion)
         Serial.println("[CommHelper] Configured as MASTER with inverted UART and RX pull-down");
     } else {
-        enumerationUartHandler = std::bind(&CommunicationHelper::enumerationUartSlaveHandler, this, std::placeholders::_1);
-        uart.begin(9600, SERIAL_8N1, TX_PIN, RX_PIN);
+        // Frames for other slaves are dropped before the frame handler
+        assignAddress(BUS_ADDR_UNASSIGNED, 0);
+        bus.begin(BUS_BASE_BAUD, TX_PIN, RX_PIN, frameHandler);
         // Use pull-down on RX pin (TX_PIN for slave due to swapped pins)
         Serial.println("[CommHelper] Configured as SLAVE with inverted UART and RX pull-down");
-        // Slave starts with enumeration handler
+
+    }
+    Serial.println("[CommHelper] UART initialized on UART2");
+
+    // Answers pin events without waiting for loop()
+    if (signalTask == nullptr) {
+        xTaskCreatePinnedToCore(
+            signalTaskEntry,    // Task function
+            "busSignal",        // Task name (for debugging)
+            3072,               // Stack size in bytes
+            this,               // Task parameter
+            BUS_SIGNAL_TASK_PRIORITY,
+            &signalTask,        // Task handle for ISR notifications
+            BUS_RX_TASK_CORE    // Core ID (0 or 1)
+        );
     }
-    Serial.println("[CommHelper] UART initialized on Serial2");
-    uart.flush();
 
+    pulseDecoder.begin(getCpuFrequencyMhz());
     attachInterrupt(digitalPinToInterrupt(SERIAL_IN_PIN), serialInputISR, CHANGE);
     Serial.println("[CommHelper] SERIAL_IN_PIN configured with interrupt");
 
-    sendUart("\n"); // Send newline to reset any partial commands
+    attachInterrupt(digitalPinToInterrupt(PARALLEL_PIN), parallelPinISR, CHANGE);
+    Serial.println("[CommHelper] PARALLEL_PIN configured with interrupt");
+
+    // A lone delimiter makes every decoder drop any partial frame
+    bus.writeDelimiter();
+
+    // Slaves may still run at a rate negotiated before a master reset
+    if (isMaster) {
+        resetBaudRate();
+    }
 
     Serial.println("[CommHelper] All communication interfaces initialized");
 }
 
+/**
+ * @brief Format a binary MAC the way WiFi.macAddress() does
+ */
+static String formatMac(const uint8_t* mac) {
+    char text[18];
+    snprintf(text, sizeof(text), "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return String(text);
+}
+
+/**
+ * @brief Wire time of an encoded frame with the given payload, in us
+ */
+static uint32_t frameTimeUs(size_t payloadLength, unsigned long baud) {
+    // 10 bits per byte; header, CRC, COBS code byte and delimiter
+    const size_t bytes = 3 + payloadLength + 2 + 2;
+    return (uint32_t)(bytes * 10ULL * 1000000ULL / baud);
+}
+
 void CommunicationHelper::beginUartEnumeration() {
+    enumerateFrom(0);
+}
+
+void CommunicationHelper::enumerateFrom(uint8_t first) {
+    if (!isMaster) {
+        return;
+    }
+    const unsigned long start = micros();
+
+    // Every slave has to hear the start frame, including newly plugged ones
+    // that still run at the base rate; it names the rate of the walk
+    resetBaudRate();
+    const unsigned long baud = enumBaud;
+    const uint32_t errorsBefore = bus.getErrorCount();
+
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
     state = ENUMERATION;
-    lastEnumerationTime = millis();
-    this->sendUart("ENUM_START");
-    delay(1000); // Give slaves time to prepare
-    this->currentSlaveIdx = 0;
-    pulseSerialOut();
-    Serial.println("[CommHelper] UART enumeration started");
+    first = min(first, slaves.size());
+    slaves.truncate(first);
+    sendWindow.reset(first);
+    xQueueReset(replies);
+    uint32_t chainHash = slaves.fingerprint();
+    xSemaphoreGiveRecursive(lock);
+
+    // Slaves switch state from their receive task as soon as the start
+    // frame has arrived, a few byte times are enough before the first
+    // pulse. From the middle of the chain the last kept slave pulses.
+    uint8_t startPayload[5];
+    startPayload[0] = first;
+    writeU32(startPayload + 1, baud);
+    if (first == 0) {
+        sendFrame(FRAME_ENUM_START, BUS_ADDR_BROADCAST, startPayload + 1, 4);
+        bus.waitTxDone();
+        bus.setBaudRate(baud);
+        delayMicroseconds(BUS_TURNAROUND_US);
+        pulseSerialOut(BUS_CHAIN_PULSE_US);
+    } else {
+        sendFrame(FRAME_ENUM_FROM, BUS_ADDR_BROADCAST, startPayload, sizeof(startPayload));
+        bus.waitTxDone();
+        bus.setBaudRate(baud);
+    }
+
+    // The next slave in the chain must answer within the time it takes to
+    // send our ACK and its reply, plus turnaround; silence ends the chain
+    const uint32_t windowUs = frameTimeUs(11, baud) + frameTimeUs(7, baud) + BUS_TURNAROUND_US;
+    const uint32_t windowMs = (windowUs + 999) / 1000 + 1;
+    uint32_t waitMs = windowMs + (first == 0 ? 0 : (BUS_TURNAROUND_US + 999) / 1000);
+
+    bool overflow = false;
+    for (;;) {
+        BusReply reply;
+        if (!waitReply(FRAME_ENUM_REPLY, BUS_ADDR_UNASSIGNED, reply, waitMs) || reply.length != 7) {
+            break;
+        }
+        waitMs = windowMs;
+
+        xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+        const int registered = slaves.add(reply.payload + 1);
+        xSemaphoreGiveRecursive(lock);
+
+        // Without an ACK the slave stays unassigned and the chain stops here
+        if (registered < 0) {
+            overflow = true;
+            break;
+        }
+        const uint8_t slaveAddress = (uint8_t)registered;
+        chainHash = SlaveRegistry::chainHash(chainHash, reply.payload + 1);
+
+        // ACK carries the MAC back so only the replying slave takes the
+        // address, plus its chain hash; it then pulses the next slave
+        uint8_t ack[11];
+        memcpy(ack, reply.payload + 1, 6);
+        ack[6] = slaveAddress;
+        writeU32(ack + 7, chainHash);
+        sendFrame(FRAME_ENUM_ACK, BUS_ADDR_BROADCAST, ack, sizeof(ack));
+    }
+
+    // With the registry full, slaves left unassigned (rejected or having
+    // missed their ACK) must stop announcing themselves on PARALLEL_PIN
+    const uint8_t full = slaves.size() >= slaves.capacity() ? 1 : 0;
+    sendFrame(FRAME_ENUM_DONE, BUS_ADDR_BROADCAST, &full, 1);
+
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    state = NORMAL;
+    xSemaphoreGiveRecursive(lock);
+
+    // A reply lost to a rate the cabling cannot carry ends the chain early
+    if (baud != BUS_BASE_BAUD && bus.getErrorCount() != errorsBefore) {
+        Serial.printf("[CommHelper] Corrupt frames while enumerating at %lu baud, repeating at %lu\n",
+                      baud, (unsigned long)BUS_BASE_BAUD);
+        enumBaud = BUS_BASE_BAUD;
+        enumerateFrom(first);
+        return;
+    }
+
+    // Logging stays out of the timed exchange above
+    Serial.printf("[CommHelper] UART enumeration from slave %u completed in %lu us, %u slave(s)\n",
+                  first, micros() - start, slaves.size());
+    if (overflow) {
+        Serial.printf("[CommHelper] Slave registry full (MAX_SLAVES %u), rest of the chain ignored\n",
+                      slaves.capacity());
+    }
+    for (uint8_t i = first; i < slaves.size(); i++) {
+        const SlaveEntry* slave = slaves.get(i);
+        Serial.printf("[CommHelper] Slave %u - MAC: %s\n", slave->address, formatMac(slave->mac).c_str());
+    }
+
+    saveTopology();
+    reportSlaves();
+
+    baudLimit = baudRateCount - 1;
+    negotiateBaudRate();
 }
 
+void CommunicationHelper::saveTopology() {
+    const uint32_t fingerprint = slaves.fingerprint();
+    if (fingerprint == savedFingerprint) {
+        return;
+    }
+    // Boxes powered up with us may not have booted yet
+    if (bootCheck && slaves.size() < savedCount) {
+        return;
+    }
+
+    uint8_t macs[MAX_SLAVES * 6];
+    for (uint8_t i = 0; i < slaves.size(); i++) {
+        memcpy(macs + i * 6, slaves.get(i)->mac, 6);
+    }
 
-void CommunicationHelper::enumerationUartMasterHandler(const String& data) {
-    Serial.printf("[CommHelper] Master received enumeration data: %s\n", data.c_str());
-    
-    slaves[this->currentSlaveIdx].idx = this->currentSlaveIdx;
-    slaves[this->currentSlaveIdx].mac = data;
-    Serial.printf("[CommHelper] Registered Slave %u with MAC %s\n", this->currentSlaveIdx, data.c_str());
-    this->currentSlaveIdx++;
-    delay(300); // Short delay before sending ACK
-    this->sendUart("ACK");
-    lastEnumerationTime = millis();
+    prefs.begin(namespaceName, false);
+    if (slaves.size() > 0) {
+        prefs.putBytes("macs", macs, slaves.size() * 6);
+    } else {
+        prefs.remove("macs");
+    }
+    prefs.putUInt("fp", fingerprint);
+    prefs.end();
+    savedFingerprint = fingerprint;
+    savedCount = slaves.size();
+}
+
+bool CommunicationHelper::restoreTopology() {
+    if (!isMaster) {
+        return false;
+    }
+
+    uint8_t macs[MAX_SLAVES * 6];
+    prefs.begin(namespaceName, true);
+    const size_t length = prefs.getBytesLength("macs");
+    const uint32_t stored = prefs.getUInt("fp", 0);
+    const size_t count = (length <= sizeof(macs) && length % 6 == 0)
+        ? prefs.getBytes("macs", macs, length) / 6 : 0;
+    prefs.end();
+
+    // The fingerprint also catches a truncated or stale blob
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    slaves.clear();
+    for (size_t i = 0; i < count; i++) {
+        slaves.add(macs + i * 6);
+    }
+    const bool valid = count > 0 && slaves.fingerprint() == stored;
+    if (!valid) {
+        slaves.clear();
+    }
+    xSemaphoreGiveRecursive(lock);
+
+    if (!valid) {
+        Serial.println("[CommHelper] No saved topology");
+        return false;
+    }
+    savedFingerprint = stored;
+    savedCount = slaves.size();
+    Serial.printf("[CommHelper] Loaded %u slave(s) from NVS, checking chain\n", slaves.size());
+
+    bootChecksLeft = BUS_BOOT_CHECKS;
+    checkBootTopology();
+    if (bus.getBaudRate() == BUS_BASE_BAUD) {
+        negotiateBaudRate();
+    }
+    return true;
+}
+
+void CommunicationHelper::checkBootTopology() {
+    bootChecksLeft--;
+    bootCheckAt = millis();
+    bootCheck = true;
+    refreshTopology();
+    bootCheck = false;
+
+    if (slaves.size() >= savedCount) {
+        bootChecksLeft = 0;
+    } else if (bootChecksLeft > 0) {
+        Serial.printf("[CommHelper] Found %u of %u saved slave(s), checking again\n",
+                      slaves.size(), savedCount);
+    } else {
+        Serial.printf("[CommHelper] Found %u of %u saved slave(s), saved list kept until the next enumeration\n",
+                      slaves.size(), savedCount);
+    }
+}
+
+uint8_t CommunicationHelper::verifyTopology() {
+    const unsigned long baud = bus.getBaudRate();
+
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    state = ENUMERATION;
+    xQueueReset(replies);
+    xSemaphoreGiveRecursive(lock);
+
+    sendFrame(FRAME_TOPO_START, BUS_ADDR_BROADCAST, nullptr, 0);
+    bus.waitTxDone();
+    delayMicroseconds(BUS_TURNAROUND_US);
+    pulseSerialOut(BUS_CHAIN_PULSE_US);
+
+    // Each slave replies and then pulses the next one, no ACK in between
+    const uint32_t windowUs = frameTimeUs(5, baud) + BUS_CHAIN_PULSE_US + BUS_TURNAROUND_US;
+    const uint32_t windowMs = (windowUs + 999) / 1000 + 1;
+
+    uint32_t chainHash = SlaveRegistry::CHAIN_SEED;
+    uint8_t position = 0;
+    for (; position < slaves.size(); position++) {
+        chainHash = SlaveRegistry::chainHash(chainHash, slaves.get(position)->mac);
+        BusReply reply;
+        if (!waitReply(FRAME_TOPO_REPLY, position, reply, windowMs) || reply.length != 5 ||
+            readU32(reply.payload + 1) != chainHash) {
+            break;
+        }
+    }
+
+    // Slaves behind a break are still waiting for their pulse
+    sendFrame(FRAME_ENUM_DONE, BUS_ADDR_BROADCAST, nullptr, 0);
+
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    state = NORMAL;
+    xSemaphoreGiveRecursive(lock);
+    return position;
+}
+
+void CommunicationHelper::refreshTopology() {
+    if (!isMaster) {
+        return;
+    }
+    topologyCheckPending = false;
+    if (slaves.size() == 0) {
+        beginUartEnumeration();
+        return;
+    }
+    // Attention servicing uses the same replies, try again on the next pass
+    if (!claimReplies()) {
+        topologyCheckPending = true;
+        return;
+    }
+
+    const unsigned long start = micros();
+    const uint8_t first = verifyTopology();
+
+    // Boxes behind the last known one are silent in the check; new boxes
+    // hold PARALLEL_PIN while unassigned
+    bool added = false;
+    if (first == slaves.size() && slaves.size() < slaves.capacity()) {
+        added = selectAttention(BUS_ADDR_UNASSIGNED, BUS_ADDR_UNASSIGNED);
+        selectAttention(0, BUS_ADDR_UNASSIGNED);
+    }
+    releaseReplies();
+
+    if (first == slaves.size() && !added) {
+        Serial.printf("[CommHelper] Chain unchanged, %u slave(s) verified in %lu us (fingerprint %08X)\n",
+                      slaves.size(), micros() - start, (unsigned)slaves.fingerprint());
+        reportSlaves();
+        return;
+    }
+
+    Serial.printf("[CommHelper] Chain changed at slave %u, re-enumerating from there\n", first);
+    enumerateFrom(first);
+}
+
+void CommunicationHelper::reportSlaves() {
+    if (webSocketHelper == nullptr || !webSocketHelper->isConnected()) {
+        return;
+    }
+    JsonDocument doc;
+    JsonArray slavesArray = doc["slaves"].to<JsonArray>();
+
+    for (uint8_t i = 0; i < slaves.size(); i++) {
+        const SlaveEntry* slave = slaves.get(i);
+        JsonObject slaveObj = slavesArray.add<JsonObject>();
+        slaveObj["idx"] = slave->address;
+        slaveObj["mac"] = formatMac(slave->mac);
+        slaveObj["groups"] = slave->groups;
+    }
+
+    String message;
+    serializeJson(doc, message);
+    webSocketHelper->sendMessage(message);
+    Serial.printf("[CommHelper] Sent enumeration results via WebSocket: %s\n", message.c_str());
 }
 
-void CommunicationHelper::enumerationUartSlaveHandler(const String& data) {
-    if (data == "ENUM_DONE") {
+void CommunicationHelper::enumerationUartSlaveHandler(const BusFrame& frame) {
+    if (frame.type == FRAME_ENUM_DONE) {
         Serial.println("[CommHelper] Slave received ENUM_DONE, ending enumeration");
         state = NORMAL;
+        releaseIfRegistryFull(frame);
         return;
     }
-    if (waitForNextRequest) {
-        Serial.printf("[CommHelper] ACK Received: %s\n", data.c_str());
-        waitForNextRequest = false;
-        pulseSerialOut();
+    if (frame.type != FRAME_ENUM_ACK || frame.length != 11 || !waitForNextRequest) {
         return;
     }
-    Serial.printf("[CommHelper] Slave received enumeration data: %s\n", data.c_str());
+
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    if (memcmp(frame.payload, mac, sizeof(mac)) != 0) {
+        return;
+    }
+
+    assignAddress(frame.payload[6], 0);
+    chainHash = readU32(frame.payload + 7);
+    waitForNextRequest = false;
+    updateParallelPin();
+    pulseSerialOut(BUS_CHAIN_PULSE_US);
+}
+
+void CommunicationHelper::releaseIfRegistryFull(const BusFrame& frame) {
+    if (address == BUS_ADDR_UNASSIGNED && frame.length == 1 && frame.payload[0] != 0) {
+        attentionSelected = false;
+        updateParallelPin();
+    }
+}
+
+void CommunicationHelper::startSlaveEnumeration(const BusFrame& frame) {
+    const bool from = frame.type == FRAME_ENUM_FROM && frame.length == 5;
+    const uint8_t first = from ? frame.payload[0] : 0;
+
+    // Every slave follows the bus to the rate of the walk, including the
+    // ones that keep their address
+    if (from || frame.length == 4) {
+        baudProbing = false;
+        bus.setBaudRate(readU32(frame.payload + (from ? 1 : 0)));
+    }
+
+    // Slaves before first keep their address; the last of them hands the
+    // chain on once the others have switched state
+    if (address < first) {
+        if (address + 1 == first) {
+            delayMicroseconds(BUS_TURNAROUND_US);
+            pulseSerialOut(BUS_CHAIN_PULSE_US);
+        }
+        return;
+    }
+
+    state = ENUMERATION;
+    assignAddress(BUS_ADDR_UNASSIGNED, 0);
+    waitForNextRequest = false;
+    receiveWindow.reset();
+    attentionSelected = true;
+    updateParallelPin();
+    Serial.println("[CommHelper] Slave entering ENUMERATION state");
 }
 
 void CommunicationHelper::handleSlaveEnumerationRequest() {
-    // Implementation for handling slave enumeration request
-    String mac = WiFi.macAddress();
-    CommunicationHelper::instance->sendUart(mac);
+    // Topology check: report the chain hash, then hand on once our reply
+    // has left the shared line
+    if (state == VERIFY) {
+        uint8_t reply[5];
+        reply[0] = address;
+        writeU32(reply + 1, chainHash);
+        sendFrame(FRAME_TOPO_REPLY, BUS_ADDR_MASTER, reply, sizeof(reply));
+        state = NORMAL;
+        bus.waitTxDone();
+        pulseSerialOut(BUS_CHAIN_PULSE_US);
+        return;
+    }
+
+    // Answer each enumeration only once, a pulse has two edges
+    if (state != ENUMERATION || address != BUS_ADDR_UNASSIGNED || waitForNextRequest) {
+        return;
+    }
+    uint8_t reply[7];
+    reply[0] = BUS_ADDR_UNASSIGNED;
+    WiFi.macAddress(reply + 1);
+    sendFrame(FRAME_ENUM_REPLY, BUS_ADDR_MASTER, reply, sizeof(reply));
     waitForNextRequest = true;
-    Serial.printf("[CommHelper] Slave sent MAC address for enumeration: %s\n", mac.c_str());
 }
 
-void CommunicationHelper::loop() {
-    // Process serial input interrupt flag (deferred from ISR)
-    if (serialInputChanged) {
-        serialInputChanged = false;
-        // handle Slave Enumeration Request
-        if (state == ENUMERATION && !isMaster) {
-            handleSlaveEnumerationRequest();
-        } else if (serialInputCallback != nullptr) {
-            serialInputCallback(serialInputState);
+void CommunicationHelper::signalTaskEntry(void* param) {
+    CommunicationHelper* helper = static_cast<CommunicationHelper*>(param);
+    for (;;) {
+        uint32_t signals = 0;
+        xTaskNotifyWait(0, ULONG_MAX, &signals, portMAX_DELAY);
+
+        // The barrier callback is the time-critical one, it runs unlocked
+        if (signals & SIGNAL_BARRIER) {
+            helper->barrierReady = false;
+            if (helper->barrierCallback != nullptr) {
+                helper->barrierCallback(helper->barrierTime);
+            }
+            // Attention deferred during the barrier may hold the line now
+            xSemaphoreTakeRecursive(helper->lock, portMAX_DELAY);
+            helper->updateParallelPin();
+            xSemaphoreGiveRecursive(helper->lock);
+        }
+
+        if (signals & SIGNAL_ATTENTION) {
+            helper->serviceAttention();
+        }
+
+        if (signals & SIGNAL_CHAIN) {
+            xSemaphoreTakeRecursive(helper->lock, portMAX_DELAY);
+            helper->handleSlaveEnumerationRequest();
+            xSemaphoreGiveRecursive(helper->lock);
+        }
+
+        if (signals & SIGNAL_STATUS) {
+            helper->sendStatusReport();
         }
     }
-    
-    // Check for available UART data
-    while (uart.available()) {
-        char c = uart.read();
-        
-        Serial.print(c); // Echo received char for debugging
-        
-        // Buffer incoming data until newline
-        if (c == '\n' || c == '\r') {
-            // Trigger callback if buffer contains data
-            if (uartBuffer.length() > 0) {
-                if (!isMaster && uartBuffer == "ENUM_START") {
-                    state = ENUMERATION;
-                    Serial.println("[CommHelper] Slave entering ENUMERATION state");
-                } else if (state == ENUMERATION)
-                    enumerationUartHandler(uartBuffer);
-                else if (uartCallback != nullptr)
-                    uartCallback(uartBuffer);
-            }
-            uartBuffer = "";
-        } else {
-            uartBuffer += c;
+}
+
+void CommunicationHelper::handleFrame(const BusFrame& frame) {
+    // Replies are picked up by the caller waiting in waitReply()
+    if (isMaster && frame.dst == BUS_ADDR_MASTER && frame.type == FRAME_DATA_ACK) {
+        if (frame.length == 6) {
+            sendWindow.acknowledge(frame.payload[0], frame.payload[1], readU32(frame.payload + 2));
         }
+        return;
+    }
+    if (isMaster && frame.dst == BUS_ADDR_MASTER &&
+        (frame.type == FRAME_ENUM_REPLY || frame.type == FRAME_TOPO_REPLY ||
+         frame.type == FRAME_BAUD_REPORT || frame.type == FRAME_ATTN_REPORT ||
+         frame.type == FRAME_STATUS_REPORT || frame.type == FRAME_GROUP_ACK)) {
+        BusReply reply;
+        reply.type = frame.type;
+        reply.length = min(frame.length, (uint8_t)sizeof(reply.payload));
+        memcpy(reply.payload, frame.payload, reply.length);
+        xQueueSend(replies, &reply, 0);
+        return;
+    }
+    if (frame.type >= FRAME_BAUD_PROBE && frame.type <= FRAME_BAUD_SET) {
+        handleBaudFrame(frame);
+        return;
+    }
+    if (frame.type >= FRAME_ATTN_SELECT && frame.type <= FRAME_ATTN_CLEAR) {
+        handleAttentionFrame(frame);
+        return;
     }
 
-    if (this->isMaster && state == ENUMERATION && millis() - lastEnumerationTime > 5000) {
-        // End enumeration
-        Serial.println("[CommHelper] UART enumeration completed");
-        for(SlaveInfo slave : this->slaves) {
-            Serial.printf("[CommHelper] Slave %u - MAC: %s\n", slave.idx, slave.mac.c_str());
+    if (!isMaster && (frame.type == FRAME_ENUM_START || frame.type == FRAME_ENUM_FROM)) {
+        startSlaveEnumeration(frame);
+    } else if (!isMaster && frame.type == FRAME_TOPO_START) {
+        if (address < BUS_ADDR_UNASSIGNED) {
+            state = VERIFY;
         }
-        this->sendUart("ENUM_DONE");
+    } else if (!isMaster && state == VERIFY && frame.type == FRAME_ENUM_DONE) {
         state = NORMAL;
-        
-        // Send enumeration results via WebSocket if connected
-        if (webSocketHelper != nullptr && webSocketHelper->isConnected()) {
-            JsonDocument doc;
-            JsonArray slavesArray = doc["slaves"].to<JsonArray>();
-            
-            for (uint8_t i = 0; i < currentSlaveIdx; i++) {
-                JsonObject slaveObj = slavesArray.add<JsonObject>();
-                slaveObj["idx"] = slaves[i].idx;
-                slaveObj["mac"] = slaves[i].mac;
+    } else if (!isMaster && state == ENUMERATION) {
+        enumerationUartSlaveHandler(frame);
+    } else if (!isMaster && frame.type == FRAME_ENUM_DONE) {
+        // Boxes that booted after ENUM_START are unassigned but not enumerating
+        releaseIfRegistryFull(frame);
+    } else if (!isMaster && frame.type == FRAME_BARRIER_ARM) {
+        enterBarrier();
+    } else if (!isMaster && frame.type == FRAME_STATUS_QUERY) {
+        if (address >= BUS_ADDR_UNASSIGNED) {
+            return;
+        }
+        // Asked alone: answer at once; in a sweep: wait for the own slot
+        if (frame.dst == address) {
+            statusDue = micros();
+        } else if (frame.dst == BUS_ADDR_BROADCAST && frame.length == 2) {
+            const uint32_t slotUs = (uint32_t)frame.payload[0] | ((uint32_t)frame.payload[1] << 8);
+            statusDue = micros() + address * slotUs;
+        } else {
+            return;
+        }
+        xTaskNotify(signalTask, SIGNAL_STATUS, eSetBits);
+    } else if (!isMaster && frame.type == FRAME_GROUP_SET) {
+        if (frame.dst != address || frame.length != 1) {
+            return;
+        }
+        assignAddress(address, frame.payload[0]);
+        const uint8_t ack[2] = {address, groups};
+        sendFrame(FRAME_GROUP_ACK, BUS_ADDR_MASTER, ack, sizeof(ack));
+    } else if (!isMaster && (frame.type == FRAME_DATA_SEQ || frame.type == FRAME_DATA_SYNC)) {
+        if (frame.dst != address || address == BUS_ADDR_UNASSIGNED) {
+            return;
+        }
+        const bool acknowledge = receiveWindow.receive(frame, [this](const uint8_t* payload, uint8_t length) {
+            if (uartCallback != nullptr) {
+                uartCallback(String((const char*)payload, length));
             }
-            
-            String message;
-            serializeJson(doc, message);
-            webSocketHelper->sendMessage(message);
-            Serial.printf("[CommHelper] Sent enumeration results via WebSocket: %s\n", message.c_str());
+        });
+        if (acknowledge) {
+            uint8_t ack[6];
+            ack[0] = address;
+            ack[1] = receiveWindow.getNext();
+            writeU32(ack + 2, receiveWindow.getSack());
+            sendFrame(FRAME_DATA_ACK, BUS_ADDR_MASTER, ack, sizeof(ack));
+        }
+    } else if ((frame.type & ~BUS_FRAME_MULTICAST) == FRAME_DATA && uartCallback != nullptr) {
+        uartCallback(String((const char*)frame.payload, frame.length));
+    }
+}
+
+void CommunicationHelper::loop() {
+    // Fallback when no receive task runs: frames are handled from here
+    bus.poll();
+
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+
+    // Process serial input edges captured by the ISR, oldest first
+    PinEdge edge;
+    while (serialEdges.pop(edge)) {
+        serialInLow = edge.level == LOW;
+        serialInChangedAt = millis();
+
+        // Enumeration pulses are answered by the signal task
+        if (state != NORMAL) {
+            pulseDecoder.reset();
+            continue;
+        }
+        if (serialInputCallback != nullptr) {
+            serialInputCallback(edge.level);
+        }
+        if (pulseDecoder.push(edge) && serialTokenCallback != nullptr) {
+            serialTokenCallback(pulseDecoder.token(), pulseDecoder.width());
+        }
+    }
+    if (serialEdgeOverflows != reportedEdgeOverflows) {
+        reportedEdgeOverflows = serialEdgeOverflows;
+        pulseDecoder.reset();
+        Serial.printf("[CommHelper] SERIAL_IN edge queue overflow (%u total)\n", (unsigned)reportedEdgeOverflows);
+    }
+
+    // Upstream box unplugged for good, or plugged in again afterwards
+    if (!isMaster && address < BUS_ADDR_UNASSIGNED) {
+        if (serialInLow && !unplugReported && millis() - serialInChangedAt > SERIAL_UNPLUG_TIMEOUT) {
+            unplugReported = true;
+            raiseAttention(ATTENTION_TOPOLOGY);
+        } else if (!serialInLow && unplugReported) {
+            unplugReported = false;
+            raiseAttention(ATTENTION_TOPOLOGY);
         }
     }
+    
+    // A probe that was never committed falls back to the last good rate
+    if (!isMaster && baudProbing && (long)(millis() - baudProbeDeadline) > 0) {
+        baudProbing = false;
+        bus.setBaudRate(baudFallback);
+        Serial.printf("[CommHelper] Baud probe not committed, back to %lu\n", baudFallback);
+    }
+
+    if (isMaster && state == NORMAL) {
+        checkErrorRate();
+    }
+
+    // A node that never gets ready must not block the others forever
+    if (barrierArmed && millis() - barrierArmedAt > BUS_BARRIER_TIMEOUT) {
+        barrierArmed = false;
+        barrierReady = false;
+        updateParallelPin();
+        Serial.println("[CommHelper] Barrier timed out");
+    }
+    xSemaphoreGiveRecursive(lock);
+
+    // Negotiation waits for replies from the receive task, so run it unlocked
+    if (negotiatePending) {
+        negotiatePending = false;
+        negotiateBaudRate();
+    }
+    if (topologyCheckPending) {
+        refreshTopology();
+    }
+    if (bootChecksLeft > 0 && millis() - bootCheckAt >= BUS_BOOT_CHECK_INTERVAL) {
+        checkBootTopology();
+    }
 }
 
 // ============================================================================
@@ -163,7 +736,95 @@ void CommunicationHelper::loop() {
 // ============================================================================
 
 void CommunicationHelper::sendUart(const String& message) {
-    uart.println(message);
+    const size_t length = min((size_t)message.length(), (size_t)BUS_MAX_PAYLOAD);
+    sendFrame(FRAME_DATA, BUS_ADDR_BROADCAST, (const uint8_t*)message.c_str(), (uint8_t)length);
+}
+
+void CommunicationHelper::sendUartToGroups(uint8_t groups, const String& message) {
+    const size_t length = min((size_t)message.length(), (size_t)BUS_MAX_PAYLOAD);
+    sendFrame(FRAME_DATA | BUS_FRAME_MULTICAST, groups, (const uint8_t*)message.c_str(), (uint8_t)length);
+}
+
+bool CommunicationHelper::setSlaveGroups(uint8_t address, uint8_t groups) {
+    SlaveEntry* entry = slaves.get(address);
+    if (!isMaster || entry == nullptr) {
+        return false;
+    }
+    // Attention servicing uses the same replies
+    if (!claimReplies()) {
+        return false;
+    }
+
+    bool confirmed = false;
+    for (int attempt = 0; attempt < 3 && !confirmed; attempt++) {
+        BusReply reply;
+        xQueueReset(replies);
+        sendFrame(FRAME_GROUP_SET, address, &groups, 1);
+        confirmed = waitReply(FRAME_GROUP_ACK, address, reply, BUS_REPLY_TIMEOUT) &&
+                    reply.length == 2 && reply.payload[1] == groups;
+    }
+    releaseReplies();
+
+    if (confirmed) {
+        entry->groups = groups;
+    }
+    Serial.printf("[CommHelper] Slave %u groups %02X %s\n", address, groups, confirmed ? "set" : "not confirmed");
+    return confirmed;
+}
+
+void CommunicationHelper::assignAddress(uint8_t address, uint8_t groups) {
+    this->address = address;
+    this->groups = groups;
+    bus.setAddressFilter(address, groups);
+}
+
+bool CommunicationHelper::sendFrame(uint8_t type, uint8_t dst, const uint8_t* payload, uint8_t length) {
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    const bool sent = sendFrame(type, dst, txSeq++, payload, length);
+    xSemaphoreGiveRecursive(lock);
+    return sent;
+}
+
+bool CommunicationHelper::sendFrame(uint8_t type, uint8_t dst, uint8_t seq, const uint8_t* payload, uint8_t length) {
+    if (length > BUS_MAX_PAYLOAD) {
+        return false;
+    }
+    BusFrame frame = {type, dst, seq, length, payload};
+    return bus.write(frame);
+}
+
+bool CommunicationHelper::sendUartTo(uint8_t address, const String& message) {
+    if (!isMaster) {
+        return false;
+    }
+    const size_t length = min((size_t)message.length(), (size_t)BUS_MAX_PAYLOAD);
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    const bool queued = sendWindow.send(address, (const uint8_t*)message.c_str(), (uint8_t)length);
+    xSemaphoreGiveRecursive(lock);
+    return queued;
+}
+
+uint8_t CommunicationHelper::getPendingCount() {
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    const uint8_t pending = sendWindow.pending();
+    xSemaphoreGiveRecursive(lock);
+    return pending;
+}
+
+bool CommunicationHelper::waitReply(uint8_t type, uint8_t src, BusReply& reply, uint32_t timeoutMs) {
+    const unsigned long start = millis();
+    for (;;) {
+        const unsigned long elapsed = millis() - start;
+        if (elapsed >= timeoutMs) {
+            return false;
+        }
+        if (xQueueReceive(replies, &reply, pdMS_TO_TICKS(timeoutMs - elapsed)) != pdTRUE) {
+            return false;
+        }
+        if (reply.type == type && reply.length > 0 && reply.payload[0] == src) {
+            return true;
+        }
+    }
 }
 
 void CommunicationHelper::setUartCallback(UartCallback callback) {
@@ -171,17 +832,170 @@ void CommunicationHelper::setUartCallback(UartCallback callback) {
     Serial.println("[CommHelper] UART callback registered");
 }
 
+// ============================================================================
+// Baud Rate Negotiation
+// ============================================================================
+
+unsigned long CommunicationHelper::negotiateBaudRate() {
+    if (!isMaster || slaves.size() == 0) {
+        return bus.getBaudRate();
+    }
+
+    for (int i = 0; i <= baudLimit && i < baudRateCount; i++) {
+        const unsigned long previous = bus.getBaudRate();
+        if (baudRates[i] <= previous) {
+            continue;
+        }
+        if (!probeBaudRate(baudRates[i])) {
+            // Slaves revert by themselves once the probe times out
+            bus.setBaudRate(previous);
+            delay(2 * BUS_BAUD_PROBE_TIMEOUT);
+            Serial.printf("[CommHelper] %lu baud failed, staying at %lu\n", baudRates[i], previous);
+            break;
+        }
+    }
+
+    // The next walk uses the enumeration rate only if the cabling carries it
+    enumBaud = bus.getBaudRate() >= BUS_ENUM_BAUD ? BUS_ENUM_BAUD : BUS_BASE_BAUD;
+
+    lastErrorCheck = millis();
+    lastFrameCount = bus.getFrameCount();
+    lastErrorCount = bus.getErrorCount();
+    Serial.printf("[CommHelper] Bus running at %lu baud\n", bus.getBaudRate());
+    return bus.getBaudRate();
+}
+
+bool CommunicationHelper::probeBaudRate(unsigned long baud) {
+    uint8_t rate[4];
+    writeU32(rate, baud);
+    sendFrame(FRAME_BAUD_PROBE, BUS_ADDR_BROADCAST, rate, sizeof(rate));
+    bus.setBaudRate(baud);
+    delay(2); // Slaves switch from their receive task
+
+    uint8_t pattern[BUS_BAUD_TEST_SIZE];
+    for (uint8_t n = 0; n < BUS_BAUD_TEST_FRAMES; n++) {
+        fillTestPattern(pattern, n);
+        sendFrame(FRAME_BAUD_TEST, BUS_ADDR_BROADCAST, pattern, sizeof(pattern));
+    }
+
+    // Every slave must have received every test frame intact
+    for (uint8_t slave = 0; slave < slaves.size(); slave++) {
+        BusReply reply;
+        xQueueReset(replies);
+        sendFrame(FRAME_BAUD_QUERY, slave, nullptr, 0);
+        if (!waitReply(FRAME_BAUD_REPORT, slave, reply, BUS_REPLY_TIMEOUT) ||
+            reply.length < 2 || reply.payload[1] != BUS_BAUD_TEST_FRAMES) {
+            return false;
+        }
+    }
+
+    // Repeated so a single corrupt frame does not strand a slave
+    for (int i = 0; i < 3; i++) {
+        sendFrame(FRAME_BAUD_COMMIT, BUS_ADDR_BROADCAST, nullptr, 0);
+    }
+    return true;
+}
+
+void CommunicationHelper::resetBaudRate() {
+    uint8_t rate[4];
+    writeU32(rate, BUS_BASE_BAUD);
+    for (int i = baudRateCount - 1; i >= 0; i--) {
+        bus.setBaudRate(baudRates[i]);
+        sendFrame(FRAME_BAUD_SET, BUS_ADDR_BROADCAST, rate, sizeof(rate));
+    }
+    bus.setBaudRate(BUS_BASE_BAUD);
+}
+
+void CommunicationHelper::handleBaudFrame(const BusFrame& frame) {
+    if (isMaster) {
+        return;
+    }
+
+    switch (frame.type) {
+        case FRAME_BAUD_PROBE:
+            if (frame.length == 4) {
+                baudFallback = bus.getBaudRate();
+                baudTestGood = 0;
+                baudProbing = true;
+                baudProbeDeadline = millis() + BUS_BAUD_PROBE_TIMEOUT;
+                bus.setBaudRate(readU32(frame.payload));
+            }
+            break;
+
+        case FRAME_BAUD_TEST:
+            if (baudProbing && frame.length == BUS_BAUD_TEST_SIZE) {
+                uint8_t expected[BUS_BAUD_TEST_SIZE];
+                fillTestPattern(expected, frame.payload[0]);
+                if (memcmp(expected, frame.payload, BUS_BAUD_TEST_SIZE) == 0) {
+                    baudTestGood++;
+                }
+            }
+            break;
+
+        case FRAME_BAUD_QUERY:
+            if (frame.dst == address) {
+                const uint8_t report[2] = {address, (uint8_t)(baudProbing ? baudTestGood : 0)};
+                sendFrame(FRAME_BAUD_REPORT, BUS_ADDR_MASTER, report, sizeof(report));
+            }
+            break;
+
+        case FRAME_BAUD_COMMIT:
+            if (baudProbing) {
+                baudProbing = false;
+                Serial.printf("[CommHelper] Bus now at %lu baud\n", bus.getBaudRate());
+            }
+            break;
+
+        case FRAME_BAUD_SET:
+            if (frame.length == 4) {
+                baudProbing = false;
+                bus.setBaudRate(readU32(frame.payload));
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void CommunicationHelper::checkErrorRate() {
+    if (millis() - lastErrorCheck < BUS_ERROR_CHECK_INTERVAL) {
+        return;
+    }
+    lastErrorCheck = millis();
+
+    const uint32_t frames = bus.getFrameCount() - lastFrameCount;
+    const uint32_t errors = bus.getErrorCount() - lastErrorCount;
+    lastFrameCount = bus.getFrameCount();
+    lastErrorCount = bus.getErrorCount();
+
+    if (bus.getBaudRate() <= BUS_BASE_BAUD || errors < 3 ||
+        errors * 100 <= (frames + errors) * BUS_MAX_ERROR_PERCENT) {
+        return;
+    }
+
+    // Renegotiate, but only below the rate that just failed
+    int failed = 0;
+    while (failed < baudRateCount && baudRates[failed] < bus.getBaudRate()) {
+        failed++;
+    }
+    Serial.printf("[CommHelper] %u of %u frames corrupt at %lu baud, falling back\n",
+                  (unsigned)errors, (unsigned)(frames + errors), bus.getBaudRate());
+    resetBaudRate();
+    baudLimit = failed - 1;
+    negotiatePending = true;
+}
+
 // ============================================================================
 // Serial Pin Communication Methods
 // ============================================================================
 
 void CommunicationHelper::pulseSerialOut(uint32_t delayUs) {
-    // Pull SERIAL_OUT_PIN LOW for 1ms pulse
+    // Pull SERIAL_OUT_PIN LOW for a short pulse; no logging here, the
+    // pulse is on the enumeration critical path
     digitalWrite(SERIAL_OUT_PIN, LOW);
-    delayMicroseconds(delayUs); // 1ms pulse
+    delayMicroseconds(delayUs);
     digitalWrite(SERIAL_OUT_PIN, HIGH);
-    
-    Serial.println("[CommHelper] SERIAL_OUT_PIN pulse sent");
 }
 
 void CommunicationHelper::setSerialInputCallback(SerialInputCallback callback) {
@@ -189,6 +1003,15 @@ void CommunicationHelper::setSerialInputCallback(SerialInputCallback callback) {
     Serial.println("[CommHelper] SERIAL_IN_PIN callback registered");
 }
 
+void CommunicationHelper::sendSerialToken(uint8_t token) {
+    pulseSerialOut(((uint32_t)token + 1) * SERIAL_TOKEN_UNIT_US);
+}
+
+void CommunicationHelper::setSerialTokenCallback(SerialTokenCallback callback) {
+    serialTokenCallback = callback;
+    Serial.println("[CommHelper] SERIAL_IN_PIN token callback registered");
+}
+
 void CommunicationHelper::setWebSocketHelper(WebSocketHelper* ws) {
     webSocketHelper = ws;
     Serial.println("[CommHelper] WebSocketHelper registered");
@@ -213,15 +1036,397 @@ void CommunicationHelper::pulseParallelPin() {
     Serial.println("[CommHelper] PARALLEL_PIN pulse sent (wired-AND)");
 }
 
+void CommunicationHelper::updateParallelPin() {
+    // The barrier owns the line while armed; attention waits for it
+    // Unassigned slaves hold as well, which announces a newly plugged box
+    const bool hold = barrierArmed
+        ? (!barrierReady || barrierArming)
+        : (!isMaster && attentionSelected &&
+           (address == BUS_ADDR_UNASSIGNED || (address < BUS_ADDR_UNASSIGNED && attentionPending != 0)));
+
+    if (hold && !parallelHeld) {
+        // Level first, so switching to OUTPUT never drives the line high
+        digitalWrite(PARALLEL_PIN, LOW);
+        pinMode(PARALLEL_PIN, OUTPUT);
+        parallelHeld = true;
+    } else if (!hold && parallelHeld) {
+        pinMode(PARALLEL_PIN, INPUT);
+        parallelHeld = false;
+    }
+}
+
+void CommunicationHelper::enterBarrier() {
+    barrierArmedAt = millis();
+    barrierArmed = true;
+    updateParallelPin();
+}
+
+bool CommunicationHelper::armBarrier() {
+    if (!isMaster) {
+        return false;
+    }
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    if (barrierArmed || attentionBusy || digitalRead(PARALLEL_PIN) == LOW) {
+        xSemaphoreGiveRecursive(lock);
+        return false;
+    }
+
+    // The master holds the line until every slave has had time to arm, so
+    // slaves that are ready early cannot release it prematurely
+    barrierArming = true;
+    enterBarrier();
+    sendFrame(FRAME_BARRIER_ARM, BUS_ADDR_BROADCAST, nullptr, 0);
+    xSemaphoreGiveRecursive(lock);
+
+    bus.waitTxDone();
+    delayMicroseconds(BUS_TURNAROUND_US);
+
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    barrierArming = false;
+    updateParallelPin();
+    xSemaphoreGiveRecursive(lock);
+    return true;
+}
+
+void CommunicationHelper::releaseBarrier() {
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    barrierReady = true;
+    updateParallelPin();
+    xSemaphoreGiveRecursive(lock);
+}
+
+void CommunicationHelper::setBarrierCallback(BarrierCallback callback) {
+    barrierCallback = callback;
+    Serial.println("[CommHelper] Barrier callback registered");
+}
+
+void CommunicationHelper::raiseAttention(uint8_t reasons) {
+    if (isMaster || reasons == 0) {
+        return;
+    }
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    attentionPending |= reasons;
+    updateParallelPin();
+    xSemaphoreGiveRecursive(lock);
+}
+
+void CommunicationHelper::setAttentionCallback(AttentionCallback callback) {
+    attentionCallback = callback;
+    Serial.println("[CommHelper] Attention callback registered");
+}
+
+void CommunicationHelper::handleAttentionFrame(const BusFrame& frame) {
+    if (isMaster) {
+        return;
+    }
+
+    switch (frame.type) {
+        case FRAME_ATTN_SELECT:
+            if (frame.length == 2) {
+                attentionSelected = address >= frame.payload[0] && address <= frame.payload[1];
+                updateParallelPin();
+            }
+            break;
+
+        case FRAME_ATTN_POLL:
+            if (frame.dst == address) {
+                const uint8_t report[2] = {address, attentionPending};
+                sendFrame(FRAME_ATTN_REPORT, BUS_ADDR_MASTER, report, sizeof(report));
+            }
+            break;
+
+        case FRAME_ATTN_CLEAR:
+            // Reasons raised after the report stay pending
+            if (frame.dst == address && frame.length == 1) {
+                attentionPending &= ~frame.payload[0];
+                updateParallelPin();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+bool CommunicationHelper::selectAttention(uint8_t lo, uint8_t hi) {
+    const uint8_t range[2] = {lo, hi};
+    sendFrame(FRAME_ATTN_SELECT, BUS_ADDR_BROADCAST, range, sizeof(range));
+    bus.waitTxDone();
+    delayMicroseconds(BUS_TURNAROUND_US);
+    return digitalRead(PARALLEL_PIN) == LOW;
+}
+
+void CommunicationHelper::findAttention(uint8_t lo, uint8_t hi, uint8_t* flagged, uint8_t& count) {
+    if (lo == hi) {
+        flagged[count++] = lo;
+        return;
+    }
+    // If the lower half is quiet the upper half must be holding the line
+    const uint8_t mid = lo + (hi - lo) / 2;
+    const bool lower = selectAttention(lo, mid);
+    if (lower) {
+        findAttention(lo, mid, flagged, count);
+    }
+    if (!lower || selectAttention(mid + 1, hi)) {
+        findAttention(mid + 1, hi, flagged, count);
+    }
+}
+
+bool CommunicationHelper::claimReplies() {
+    bool expected = false;
+    return attentionBusy.compare_exchange_strong(expected, true);
+}
+
+void CommunicationHelper::releaseReplies() {
+    attentionBusy = false;
+    // Edges were ignored while claimed, the slave may still hold the line
+    if (attentionDeferred.exchange(false) && signalTask != nullptr) {
+        xTaskNotify(signalTask, SIGNAL_ATTENTION, eSetBits);
+    }
+}
+
+void CommunicationHelper::serviceAttention() {
+    if (!isMaster || state != NORMAL || barrierArmed || slaves.size() == 0) {
+        return;
+    }
+    // An exchange from loop() owns the replies, come back when it releases them
+    if (!claimReplies()) {
+        attentionDeferred = true;
+        return;
+    }
+
+    // Requests raised while servicing keep the line low without a new edge
+    for (int round = 0; round < 4 && digitalRead(PARALLEL_PIN) == LOW && !barrierArmed; round++) {
+        uint8_t flagged[MAX_SLAVES];
+        uint8_t count = 0;
+        const unsigned long start = micros();
+
+        // A holder without address is a newly plugged box
+        if (slaves.size() < slaves.capacity() && selectAttention(BUS_ADDR_UNASSIGNED, BUS_ADDR_UNASSIGNED)) {
+            topologyCheckPending = true;
+        }
+        if (selectAttention(0, slaves.size() - 1)) {
+            findAttention(0, slaves.size() - 1, flagged, count);
+        }
+
+        // Every flagged slave holds again until it is cleared; unassigned
+        // boxes only while the registry has room for them
+        selectAttention(0, slaves.size() < slaves.capacity() ? BUS_ADDR_UNASSIGNED : slaves.size() - 1);
+
+        for (uint8_t i = 0; i < count; i++) {
+            const uint8_t slave = flagged[i];
+            SlaveEntry* entry = slaves.get(slave);
+            if (entry != nullptr) {
+                entry->flags |= SLAVE_ATTENTION;
+            }
+            BusReply reply;
+            xQueueReset(replies);
+            sendFrame(FRAME_ATTN_POLL, slave, nullptr, 0);
+            if (!waitReply(FRAME_ATTN_REPORT, slave, reply, BUS_REPLY_TIMEOUT) || reply.length < 2) {
+                continue;
+            }
+            const uint8_t reasons = reply.payload[1];
+            sendFrame(FRAME_ATTN_CLEAR, slave, &reasons, 1);
+            if (entry != nullptr) {
+                entry->flags &= ~SLAVE_ATTENTION;
+            }
+            if (reasons & ATTENTION_TOPOLOGY) {
+                topologyCheckPending = true;
+            }
+            const uint8_t appReasons = reasons & ~ATTENTION_TOPOLOGY;
+            if (appReasons != 0 && attentionCallback != nullptr) {
+                attentionCallback(slave, appReasons);
+            }
+        }
+        Serial.printf("[CommHelper] Serviced %u attention request(s) in %lu us\n", count, micros() - start);
+        if (count == 0) {
+            break;
+        }
+    }
+
+    // Our own selection edges are covered by the line check above
+    attentionDeferred = false;
+    releaseReplies();
+}
+
+// ============================================================================
+// Status Sweep
+// ============================================================================
+
+static_assert(BUS_STATUS_SIZE + 1 <= 16, "a status report must fit into BusReply");
+
+uint8_t CommunicationHelper::sweepStatus() {
+    if (!isMaster || state != NORMAL || slaves.size() == 0) {
+        return 0;
+    }
+    // Attention servicing uses the same replies, skip this sweep
+    if (!claimReplies()) {
+        return 0;
+    }
+
+    const uint8_t count = slaves.size();
+    const unsigned long start = micros();
+    uint8_t status[MAX_SLAVES][BUS_STATUS_SIZE];
+    int8_t lengths[MAX_SLAVES];     // -1 until the slave's report arrived
+    memset(lengths, -1, sizeof(lengths));
+    uint8_t received = 0;
+
+    auto store = [&](const BusReply& reply) {
+        const uint8_t slave = reply.payload[0];
+        if (reply.type != FRAME_STATUS_REPORT || reply.length == 0 || slave >= count || lengths[slave] >= 0) {
+            return;
+        }
+        lengths[slave] = min((int)reply.length - 1, BUS_STATUS_SIZE);
+        memcpy(status[slave], reply.payload + 1, lengths[slave]);
+        received++;
+    };
+
+    // Slave n reports n slots after the query, back to back on the wire
+    const uint32_t slotUs = frameTimeUs(1 + BUS_STATUS_SIZE, bus.getBaudRate()) + BUS_STATUS_GUARD_US;
+    const uint8_t query[2] = {(uint8_t)(slotUs & 0xFF), (uint8_t)(slotUs >> 8)};
+    xQueueReset(replies);
+    sendFrame(FRAME_STATUS_QUERY, BUS_ADDR_BROADCAST, query, sizeof(query));
+    bus.waitTxDone();
+
+    const unsigned long sent = micros();
+    const uint32_t windowUs = count * slotUs + BUS_TURNAROUND_US;
+    while (received < count) {
+        const unsigned long elapsed = micros() - sent;
+        if (elapsed >= windowUs) {
+            break;
+        }
+        BusReply reply;
+        if (xQueueReceive(replies, &reply, pdMS_TO_TICKS((windowUs - elapsed) / 1000 + 1)) != pdTRUE) {
+            break;
+        }
+        store(reply);
+    }
+
+    // Reports lost to a collision or a late slave: ask once more, one by one
+    for (uint8_t slave = 0; slave < count && received < count; slave++) {
+        if (lengths[slave] >= 0) {
+            continue;
+        }
+        BusReply reply;
+        xQueueReset(replies);
+        sendFrame(FRAME_STATUS_QUERY, slave, nullptr, 0);
+        if (waitReply(FRAME_STATUS_REPORT, slave, reply, BUS_REPLY_TIMEOUT)) {
+            store(reply);
+        }
+    }
+    releaseReplies();
+    const unsigned long elapsed = micros() - start;
+
+    // One message for the whole chain
+    JsonDocument doc;
+    JsonArray statusArray = doc["status"].to<JsonArray>();
+    JsonArray missingArray = doc["missing"].to<JsonArray>();
+    for (uint8_t slave = 0; slave < count; slave++) {
+        SlaveEntry* entry = slaves.get(slave);
+        if (lengths[slave] < 0) {
+            entry->flags &= ~SLAVE_ONLINE;
+            missingArray.add(slave);
+            continue;
+        }
+        entry->flags |= SLAVE_ONLINE;
+
+        char hex[2 * BUS_STATUS_SIZE + 1];
+        for (int8_t i = 0; i < lengths[slave]; i++) {
+            snprintf(hex + 2 * i, 3, "%02X", status[slave][i]);
+        }
+        hex[2 * lengths[slave]] = '\0';
+        JsonArray slaveStatus = statusArray.add<JsonArray>();
+        slaveStatus.add(slave);
+        slaveStatus.add(hex);
+    }
+    doc["us"] = elapsed;
+
+    Serial.printf("[CommHelper] Status sweep: %u of %u slave(s) in %lu us\n", received, count, elapsed);
+    if (webSocketHelper != nullptr && webSocketHelper->isConnected()) {
+        String message;
+        serializeJson(doc, message);
+        webSocketHelper->sendMessage(message);
+    }
+    return received;
+}
+
+void CommunicationHelper::setStatusProvider(StatusProvider provider) {
+    statusProvider = provider;
+}
+
+void CommunicationHelper::sendStatusReport() {
+    // Filled in before the slot so the report leaves right at its start
+    uint8_t report[1 + BUS_STATUS_SIZE];
+    report[0] = address;
+    uint8_t length = 0;
+    if (statusProvider != nullptr) {
+        length = min(statusProvider(report + 1), (uint8_t)BUS_STATUS_SIZE);
+    }
+
+    // Sleep through most of the wait, spin the last part
+    long remaining = (long)(statusDue - micros());
+    if (remaining > 2000) {
+        vTaskDelay(pdMS_TO_TICKS((remaining - 1000) / 1000));
+    }
+    remaining = (long)(statusDue - micros());
+    if (remaining > 0) {
+        delayMicroseconds(remaining);
+    }
+    sendFrame(FRAME_STATUS_REPORT, BUS_ADDR_MASTER, report, 1 + length);
+}
+
 // ============================================================================
 // ISR Handlers
 // ============================================================================
 
 void IRAM_ATTR CommunicationHelper::serialInputISR() {
     if (instance != nullptr) {
-        // Read pin state and set flag for deferred processing in loop()
-        // This keeps ISR fast and avoids callback execution in interrupt context
-        instance->serialInputState = digitalRead(SERIAL_IN_PIN);
-        instance->serialInputChanged = true;
+        // Timestamp first, then queue the edge for loop(); callbacks never
+        // run in interrupt context
+        const PinEdge edge = {cpu_hal_get_cycle_count(), (uint8_t)digitalRead(SERIAL_IN_PIN)};
+        if (!instance->serialEdges.push(edge)) {
+            instance->serialEdgeOverflows++;
+        }
+
+        // Falling edge during enumeration: our turn to reply
+        if (!instance->isMaster && instance->signalTask != nullptr && edge.level == LOW) {
+            BaseType_t woken = pdFALSE;
+            xTaskNotifyFromISR(instance->signalTask, SIGNAL_CHAIN, eSetBits, &woken);
+            if (woken == pdTRUE) {
+                portYIELD_FROM_ISR();
+            }
+        }
+    }
+}
+
+void IRAM_ATTR CommunicationHelper::parallelPinISR() {
+    if (instance == nullptr || instance->signalTask == nullptr) {
+        return;
+    }
+
+    const int level = digitalRead(PARALLEL_PIN);
+    uint32_t signal = 0;
+
+    if (instance->barrierArmed && level == HIGH) {
+        // Rising edge with the barrier armed: the last node has released it
+        instance->barrierTime = esp_timer_get_time();
+        instance->barrierArmed = false;
+        signal = SIGNAL_BARRIER;
+    } else if (instance->isMaster && !instance->barrierArmed && level == LOW) {
+        // Falling edge outside a barrier: a slave wants attention, once the
+        // replies are free again
+        if (instance->attentionBusy) {
+            instance->attentionDeferred = true;
+        } else {
+            signal = SIGNAL_ATTENTION;
+        }
+    }
+
+    if (signal != 0) {
+        BaseType_t woken = pdFALSE;
+        xTaskNotifyFromISR(instance->signalTask, signal, eSetBits, &woken);
+        if (woken == pdTRUE) {
+            portYIELD_FROM_ISR();
+        }
     }
 }
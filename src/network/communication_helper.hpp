@@ -2,9 +2,16 @@
 #define COMMUNICATION_HELPER_HPP
 
 #include <Arduino.h>
-#include <HardwareSerial.h>
+#include <Preferences.h>
+#include <atomic>
 #include <functional>
 #include "defines.hpp"
+#include "bus_frame.hpp"
+#include "bus_uart.hpp"
+#include "slave_registry.hpp"
+#include "bus_window.hpp"
+#include "pulse_decoder.hpp"
+#include "spsc_ring.hpp"
 
 // Forward declaration
 class WebSocketHelper;
@@ -13,9 +20,9 @@ class WebSocketHelper;
  * @brief Communication helper for inter-MedBox communication
  * 
  * Manages three types of communication between MedBox controllers:
- * 1. UART: Standard UART on Serial2 (TX_PIN 17, RX_PIN 16)
+ * 1. UART: Binary frames (see bus_frame.hpp) on Serial2 (TX_PIN 17, RX_PIN 16)
  * 2. Serial pins: Chain communication with interrupt-driven input
- * 3. Parallel pin: Wired-AND broadcast communication
+ * 3. Parallel pin: Wired-AND start barrier and slave attention requests
  * 
  * All communication uses pins defined in defines.hpp.
  */
@@ -23,7 +30,7 @@ class CommunicationHelper {
 public:
     /**
      * @brief Callback type for received UART data
-     * @param data Received string from UART
+     * @param data Payload of a received FRAME_DATA frame
      */
     using UartCallback = std::function<void(const String& data)>;
     
@@ -33,13 +40,46 @@ public:
      */
     using SerialInputCallback = std::function<void(int state)>;
 
-    struct SlaveInfo {
-        uint8_t idx;
-        String mac;
+    /**
+     * @brief Callback type for a pulse token decoded on SERIAL_IN_PIN
+     * @param token Token number, see PulseDecoder
+     * @param widthUs Measured pulse width
+     */
+    using SerialTokenCallback = std::function<void(uint8_t token, uint32_t widthUs)>;
+
+    /**
+     * @brief Callback type for a released barrier
+     * @param releasedAt esp_timer time of the rising edge on PARALLEL_PIN, in us
+     */
+    using BarrierCallback = std::function<void(int64_t releasedAt)>;
+
+    /**
+     * @brief Callback type for a serviced attention request (master)
+     * @param address Slave that raised it
+     * @param reasons Application-defined reason bits, ORed since the last report
+     */
+    using AttentionCallback = std::function<void(uint8_t address, uint8_t reasons)>;
+
+    /**
+     * @brief Fills this slave's status report (pill counts, motor state, error flags)
+     * @param status Buffer of BUS_STATUS_SIZE bytes
+     * @return Number of bytes filled in
+     */
+    using StatusProvider = std::function<uint8_t(uint8_t* status)>;
+
+    /**
+     * @brief Attention reason bits reserved by the helper
+     * 
+     * Application reasons use the remaining bits.
+     */
+    enum AttentionReason : uint8_t {
+        ATTENTION_TOPOLOGY = 0x80   ///< Upstream cable changed, master checks the chain
     };
 
-    // Example array size, adjust as needed
-    SlaveInfo slaves[MAX_SLAVES];
+    /**
+     * @brief Slaves found by the last enumeration (master only)
+     */
+    SlaveRegistry slaves;
 
     CommunicationHelper();
     
@@ -47,7 +87,7 @@ public:
      * @brief Initialize all communication interfaces
      * 
      * Sets up:
-     * - UART on Serial2 with 115200 baud rate
+     * - UART2 driver with the event-driven bus receive task
      * - SERIAL_IN_PIN as INPUT with interrupt
      * - SERIAL_OUT_PIN as OUTPUT (initially HIGH)
      * - PARALLEL_PIN as INPUT (high-impedance for wired-AND)
@@ -55,10 +95,10 @@ public:
     void begin(bool isMaster);
     
     /**
-     * @brief Process incoming UART data (must be called in main loop)
+     * @brief Process deferred pin events and timeouts (must be called in main loop)
      * 
-     * Checks for available UART data and triggers callback
-     * if data is received.
+     * UART frames are handled by the bus receive task as they arrive; only
+     * when that task is unavailable are buffered bytes decoded here.
      */
     void loop();
     
@@ -69,8 +109,73 @@ public:
     /**
      * @brief Send string via UART
      * @param message String to send to other MedBox controllers
+     * 
+     * Broadcast as the payload of a FRAME_DATA frame, truncated to
+     * BUS_MAX_PAYLOAD bytes.
      */
     void sendUart(const String& message);
+
+    /**
+     * @brief Send string to the slaves of some groups with one frame (master only)
+     * 
+     * Multicast FRAME_DATA, unacknowledged like sendUart(). Slaves outside
+     * the groups drop it in their frame decoder.
+     * 
+     * @param groups Group mask, see setSlaveGroups()
+     * @param message Payload, truncated to BUS_MAX_PAYLOAD bytes
+     */
+    void sendUartToGroups(uint8_t groups, const String& message);
+
+    /**
+     * @brief Put a slave into multicast groups (master only)
+     * 
+     * Waits for the slave to confirm, retrying twice. The groups are kept
+     * in the registry entry until the slave is enumerated again.
+     * 
+     * @param address Slave address
+     * @param groups Mask of up to eight groups, e.g. one bit per ward
+     * @return false if the slave did not confirm or the bus is busy
+     */
+    bool setSlaveGroups(uint8_t address, uint8_t groups);
+
+    /**
+     * @brief Encode and send one bus frame
+     * @param type Frame type (BusFrameType)
+     * @param dst Destination address or BUS_ADDR_BROADCAST
+     * @param payload Payload bytes, may be nullptr if length is 0
+     * @param length Payload length, at most BUS_MAX_PAYLOAD
+     * @return false if the frame is too long
+     */
+    bool sendFrame(uint8_t type, uint8_t dst, const uint8_t* payload, uint8_t length);
+
+    /**
+     * @brief Queue a message for reliable, in-order delivery to one slave (master only)
+     * 
+     * Returns at once; frames to many slaves are pipelined (see SendWindow)
+     * and delivered to the slave's UART callback like FRAME_DATA.
+     * 
+     * @param address Slave address
+     * @param message Payload, truncated to BUS_MAX_PAYLOAD bytes
+     * @return false if the send queue is full or address is no slave
+     */
+    bool sendUartTo(uint8_t address, const String& message);
+
+    /**
+     * @brief Messages queued by sendUartTo() and not yet acknowledged
+     */
+    uint8_t getPendingCount();
+
+    /**
+     * @brief Bus address assigned during enumeration
+     * @return BUS_ADDR_MASTER on the master, BUS_ADDR_UNASSIGNED before
+     *         a slave was enumerated
+     */
+    uint8_t getAddress() const { return address; }
+
+    /**
+     * @brief Multicast groups this slave belongs to
+     */
+    uint8_t getGroups() const { return groups; }
     
     /**
      * @brief Set callback for received UART data
@@ -93,8 +198,28 @@ public:
     /**
      * @brief Set callback for SERIAL_IN_PIN interrupt
      * @param callback Function to call when SERIAL_IN_PIN changes state
+     * 
+     * Called from loop() once per captured edge, in order; edges between
+     * loop() passes are queued, not merged.
      */
     void setSerialInputCallback(SerialInputCallback callback);
+
+    /**
+     * @brief Send a pulse-width coded token on SERIAL_OUT_PIN
+     * 
+     * Blocks for the pulse, (token + 1) * SERIAL_TOKEN_UNIT_US.
+     */
+    void sendSerialToken(uint8_t token);
+
+    /**
+     * @brief Set callback for tokens decoded on SERIAL_IN_PIN (from loop())
+     */
+    void setSerialTokenCallback(SerialTokenCallback callback);
+
+    /**
+     * @brief Edges lost because the capture queue was full
+     */
+    uint32_t getSerialEdgeOverflows() const { return serialEdgeOverflows; }
     
     // ========================================================================
     // Parallel Pin Communication (Wired-AND)
@@ -112,8 +237,152 @@ public:
      */
     void pulseParallelPin();
 
+    /**
+     * @brief Arm the start barrier on all nodes (master only)
+     * 
+     * Holds PARALLEL_PIN low and broadcasts FRAME_BARRIER_ARM; every slave
+     * that has not called releaseBarrier() yet holds the line as well.
+     * Each node lets go in releaseBarrier(); the line rises when the last
+     * one does, and the rising-edge interrupt runs the barrier callback on
+     * every node within microseconds of the others.
+     * 
+     * Blocks for one frame time plus BUS_TURNAROUND_US so slaves have
+     * armed before the master can release.
+     * 
+     * @return false if a barrier is already armed or PARALLEL_PIN is held
+     *         by an attention request that has not been serviced yet
+     */
+    bool armBarrier();
+
+    /**
+     * @brief Mark this node ready for the barrier
+     * 
+     * Releases PARALLEL_PIN if the barrier is armed; if not, the node does
+     * not hold the line when the next barrier is armed. Nodes give up a
+     * barrier after BUS_BARRIER_TIMEOUT ms, which releases the others.
+     */
+    void releaseBarrier();
+
+    bool isBarrierArmed() const { return barrierArmed; }
+
+    /**
+     * @brief Set callback for a released barrier
+     * 
+     * Runs on the signal task, not in the interrupt.
+     */
+    void setBarrierCallback(BarrierCallback callback);
+
+    /**
+     * @brief Ask the master for attention (slave only)
+     * 
+     * Holds PARALLEL_PIN low until the master has fetched and cleared the
+     * reasons. The master catches the falling edge in an interrupt, finds
+     * the flagged slaves by binary splitting (FRAME_ATTN_SELECT narrows the
+     * range of slaves that keep holding, the master samples the line), and
+     * polls only those. Cost grows with the number of flagged slaves times
+     * log2 of the chain length, not with the chain length.
+     * 
+     * Delivery is at least once: a lost clear makes the slave report the
+     * same reasons again. Deferred while a barrier is armed.
+     * 
+     * Unassigned slaves hold the line as well, to announce a new box. Once
+     * the registry is full they are deselected (FRAME_ENUM_DONE with the
+     * full flag, and no longer reselected after servicing) so they cannot
+     * keep the line low for good.
+     * 
+     * @param reasons Application-defined bits, ORed with pending ones
+     */
+    void raiseAttention(uint8_t reasons);
+
+    /**
+     * @brief Set callback for attention requests (master only)
+     * 
+     * Runs on the signal task.
+     */
+    void setAttentionCallback(AttentionCallback callback);
+
+    /**
+     * @brief Collect the status of all slaves and report it via WebSocket (master only)
+     * 
+     * One broadcast FRAME_STATUS_QUERY: slave n sends its report n slots
+     * later (see BUS_STATUS_SIZE), so the replies stream back without a
+     * round trip each and the sweep takes about the wire time of all
+     * reports. Slaves whose report was lost are asked once more one by one.
+     * 
+     * The result goes out as one WebSocket message,
+     * {"status":[[idx,"hex"],...],"missing":[idx,...],"us":sweep time}.
+     * Slaves that did not answer lose SLAVE_ONLINE.
+     * 
+     * @return Number of slaves that answered
+     */
+    uint8_t sweepStatus();
+
+    /**
+     * @brief Set the provider of this slave's status report (slave only)
+     * 
+     * Runs on the signal task before the report's slot starts.
+     */
+    void setStatusProvider(StatusProvider provider);
+
+    /**
+     * @brief Enumerate the slave chain (master only)
+     * 
+     * Resets all slaves to the base rate, broadcasts ENUM_START, switches
+     * the bus to BUS_ENUM_BAUD and pulses SERIAL_OUT. Each slave replies
+     * with its MAC, gets its address in the ACK and pulses the next one.
+     * The chain ends when no reply arrives within the wire time of one ACK
+     * and one reply plus BUS_TURNAROUND_US. Blocks until done (about 1 ms
+     * per slave, see BUS_ENUM_BAUD), then reports the slaves via WebSocket
+     * and negotiates the baud rate.
+     */
     void beginUartEnumeration();
 
+    /**
+     * @brief Check the chain and re-enumerate only what changed (master only)
+     * 
+     * Walks the chain once with FRAME_TOPO_START: every enumerated slave
+     * reports the chain hash it got at enumeration (see
+     * SlaveRegistry::chainHash()) and pulses the next one. The first
+     * position with a missing, foreign or wrong reply, or a new box holding
+     * PARALLEL_PIN at the end, is re-enumerated from there on; slaves
+     * before it keep address and message streams. An unchanged chain only
+     * costs the walk and is reported via WebSocket as after an enumeration.
+     * 
+     * Also runs from loop() after a hot-plug was noticed: a new box holds
+     * PARALLEL_PIN while unassigned, a box whose upstream cable changed
+     * raises ATTENTION_TOPOLOGY, and a slave that stops acknowledging
+     * messages may have been removed.
+     */
+    void refreshTopology();
+
+    /**
+     * @brief Load the slave list saved by the last enumeration (master only)
+     * 
+     * The list and its fingerprint live in the "topology" NVS namespace.
+     * A list that loads intact is checked with refreshTopology(), so after
+     * a reboot of the master alone the bus is usable as soon as one chain
+     * walk has passed, without waiting for the WebSocket. When the whole
+     * system powers up, the slaves are still unassigned and the check ends
+     * in a full enumeration, so the list saves nothing there.
+     * 
+     * A check that finds fewer slaves than saved (boxes still booting) is
+     * repeated from loop() and does not overwrite the saved list, see
+     * BUS_BOOT_CHECKS.
+     * 
+     * @return true if a saved list was loaded
+     */
+    bool restoreTopology();
+
+    /**
+     * @brief Raise the bus baud rate as far as all slaves follow (master only)
+     * 
+     * Runs automatically after enumeration. Blocks for the duration of the
+     * probes; must not be called from the bus receive task.
+     * 
+     * @return Baud rate in use afterwards
+     */
+    unsigned long negotiateBaudRate();
+
     /**
      * @brief Set WebSocketHelper for sending enumeration results
      * @param ws Pointer to WebSocketHelper instance
@@ -121,26 +390,126 @@ public:
     void setWebSocketHelper(WebSocketHelper* ws);
     
 private:
-    HardwareSerial uart;
+    BusUart bus;
+
+    /**
+     * @brief Serialises the receive task with loop() and the public API
+     */
+    SemaphoreHandle_t lock;
     UartCallback uartCallback;
     SerialInputCallback serialInputCallback;
+    SerialTokenCallback serialTokenCallback;
 
     enum State {
         NORMAL,
-        ENUMERATION
+        ENUMERATION,
+        VERIFY              // Slave: report the chain hash on the next pulse
     } state;
 
-    bool isMaster;    
-    String uartBuffer;
+    bool isMaster;
+    uint8_t address;
+    uint8_t groups = 0;
+    uint8_t txSeq;
+
+    /**
+     * @brief Change the slave's address and groups, and its frame filter with them
+     */
+    void assignAddress(uint8_t address, uint8_t groups);
     
-    // ISR flag and state for deferred processing
-    volatile bool serialInputChanged;
-    volatile int serialInputState;
+    // SERIAL_IN edges captured by the ISR, consumed by loop()
+    SpscRing<PinEdge, SERIAL_EDGE_QUEUE_SIZE> serialEdges;
+    volatile uint32_t serialEdgeOverflows = 0;
+    uint32_t reportedEdgeOverflows = 0;
+    PulseDecoder pulseDecoder;
+
+    void enumerationUartSlaveHandler(const BusFrame& frame);
+
+    /**
+     * @brief Enumerate the chain from address first on, keeping the slaves before
+     */
+    void enumerateFrom(uint8_t first);
+
+    /**
+     * @brief Walk the chain with FRAME_TOPO_START
+     * @return First position whose reply does not match the registry
+     */
+    uint8_t verifyTopology();
+
+    /**
+     * @brief Send the slave list via WebSocket if connected
+     */
+    void reportSlaves();
+
+    /**
+     * @brief Slave: stop holding PARALLEL_PIN while unassigned if the
+     *        FRAME_ENUM_DONE says the master's registry is full
+     */
+    void releaseIfRegistryFull(const BusFrame& frame);
+
+    /**
+     * @brief Slave: handle FRAME_ENUM_START or FRAME_ENUM_FROM
+     */
+    void startSlaveEnumeration(const BusFrame& frame);
+
+    /**
+     * @brief Save the slave list and fingerprint if they changed
+     * 
+     * Skipped while a boot check found fewer slaves than saved.
+     */
+    void saveTopology();
+
+    /**
+     * @brief Run one boot check of the saved list
+     */
+    void checkBootTopology();
+
+    Preferences prefs;
+    const char* namespaceName = "topology";
+    uint32_t savedFingerprint = 0;
+    unsigned long enumBaud = BUS_ENUM_BAUD; // master: rate of the enumeration walk
+    uint8_t savedCount = 0;                 // master: slaves in the saved list
+    uint8_t bootChecksLeft = 0;
+    unsigned long bootCheckAt = 0;
+    bool bootCheck = false;                 // master: inside checkBootTopology()
+
+    uint32_t chainHash = 0;                 // slave: hash through this box
+    bool topologyCheckPending = false;      // master: refreshTopology() from loop()
+    bool serialInLow = false;
+    bool unplugReported = false;
+    unsigned long serialInChangedAt = 0;
 
-    using EnumerationUartHandler = std::function<void(const String& data)>;
-    EnumerationUartHandler enumerationUartHandler;
-    void enumerationUartMasterHandler(const String& data);
-    void enumerationUartSlaveHandler(const String& data);
+    /**
+     * @brief Notification bits of the signal task
+     */
+    enum Signal : uint32_t {
+        SIGNAL_CHAIN   = 0x01,   ///< Enumeration pulse on SERIAL_IN (slave)
+        SIGNAL_BARRIER = 0x02,   ///< PARALLEL_PIN rose with the barrier armed
+        SIGNAL_ATTENTION = 0x04, ///< PARALLEL_PIN fell outside a barrier (master)
+        SIGNAL_STATUS  = 0x08    ///< Status query received, report in its slot (slave)
+    };
+
+    /**
+     * @brief Task handling pin events signalled by the ISRs
+     * 
+     * Woken directly from serialInputISR() and parallelPinISR(), so the MAC
+     * reply or barrier callback runs within microseconds instead of on the
+     * next loop() pass.
+     */
+    static void signalTaskEntry(void* param);
+    TaskHandle_t signalTask = nullptr;
+
+    /**
+     * @brief Route one decoded frame to enumeration or the UART callback
+     */
+    void handleFrame(const BusFrame& frame);
+
+    /**
+     * @brief Send a frame with an explicit sequence number, lock held
+     */
+    bool sendFrame(uint8_t type, uint8_t dst, uint8_t seq, const uint8_t* payload, uint8_t length);
+
+    SendWindow sendWindow;          // master
+    ReceiveWindow receiveWindow;    // slave
 
     /**
      * @brief Static instance pointer for ISR callbacks
@@ -152,19 +521,144 @@ private:
     /**
      * @brief Static ISR handler for SERIAL_IN_PIN interrupt
      * 
-     * Sets flag and reads pin state for processing in main loop.
+     * Queues the level with a cycle-counter timestamp for loop().
      */
     static void IRAM_ATTR serialInputISR();
 
-    uint8_t currentSlaveIdx = 0;
+    /**
+     * @brief Static ISR handler for PARALLEL_PIN edges
+     */
+    static void IRAM_ATTR parallelPinISR();
 
-    unsigned long lastEnumerationTime = 0;
+    // ========================================================================
+    // Barrier on PARALLEL_PIN
+    // ========================================================================
+
+    /**
+     * @brief Arm locally: hold the line unless already ready
+     */
+    void enterBarrier();
+
+    /**
+     * @brief Hold or release PARALLEL_PIN as the barrier and attention state require
+     */
+    void updateParallelPin();
+
+    BarrierCallback barrierCallback;
+    volatile bool barrierArmed = false;
+    volatile int64_t barrierTime = 0;
+    bool parallelHeld = false;
+    bool barrierReady = false;
+    bool barrierArming = false;       // master guard while slaves arm
+    unsigned long barrierArmedAt = 0;
+
+    // ========================================================================
+    // Attention requests on PARALLEL_PIN
+    // ========================================================================
+
+    /**
+     * @brief Find, poll and clear all flagged slaves (master, signal task)
+     */
+    void serviceAttention();
+
+    /**
+     * @brief Collect flagged slaves in [lo, hi], known to hold the line
+     */
+    void findAttention(uint8_t lo, uint8_t hi, uint8_t* flagged, uint8_t& count);
+
+    /**
+     * @brief Let only flagged slaves in [lo, hi] hold and sample the line
+     * @return true if one of them is holding it
+     */
+    bool selectAttention(uint8_t lo, uint8_t hi);
+
+    /**
+     * @brief Claim the replies queue for a master exchange
+     * 
+     * Attention servicing on the signal task and the topology check, status
+     * sweep and group assignment from loop() all reset and read replies, so
+     * only one of them may run at a time.
+     * 
+     * @return false if another exchange holds it
+     */
+    bool claimReplies();
+
+    /**
+     * @brief Release the replies queue, service attention deferred meanwhile
+     */
+    void releaseReplies();
+
+    void handleAttentionFrame(const BusFrame& frame);
+
+    AttentionCallback attentionCallback;
+    std::atomic<bool> attentionBusy{false};     // replies claimed, ignore edges
+    std::atomic<bool> attentionDeferred{false}; // request arrived while claimed
+    uint8_t attentionPending = 0;           // slave reasons not yet cleared
+    bool attentionSelected = true;          // slave inside the selected range
+
+    // ========================================================================
+    // Status sweep
+    // ========================================================================
+
+    /**
+     * @brief Send this slave's status report once its slot has come (signal task)
+     */
+    void sendStatusReport();
+
+    StatusProvider statusProvider;
+    unsigned long statusDue = 0;            // slave: micros() when the slot starts
 
     void handleSlaveEnumerationRequest();
 
     bool waitForNextRequest = false;
 
     WebSocketHelper* webSocketHelper = nullptr;
+
+    // ========================================================================
+    // Replies to the master, handed from the receive task to waiting callers
+    // ========================================================================
+
+    struct BusReply {
+        uint8_t type;
+        uint8_t length;
+        uint8_t payload[16];
+    };
+
+    QueueHandle_t replies = nullptr;
+
+    /**
+     * @brief Wait for a reply frame of the given type from slave src
+     * @param reply Receives the reply; payload[0] is the sender address
+     * @return false on timeout
+     */
+    bool waitReply(uint8_t type, uint8_t src, BusReply& reply, uint32_t timeoutMs);
+
+    // ========================================================================
+    // Baud rate negotiation
+    // ========================================================================
+
+    bool probeBaudRate(unsigned long baud);
+
+    /**
+     * @brief Tell slaves at any negotiated rate to return to BUS_BASE_BAUD
+     */
+    void resetBaudRate();
+    void handleBaudFrame(const BusFrame& frame);
+    void checkErrorRate();
+
+    bool negotiatePending = false;
+    int baudLimit = 0;                // highest BUS_BAUD_RATES index to try
+
+    // Slave side of a probe
+    bool baudProbing = false;
+    unsigned long baudFallback = BUS_BASE_BAUD;
+    unsigned long baudProbeDeadline = 0;
+    uint8_t baudTestGood = 0;
+
+    // Master error-rate monitor
+    unsigned long lastErrorCheck = 0;
+    uint32_t lastFrameCount = 0;
+    uint32_t lastErrorCount = 0;
 };
 
 #endif // COMMUNICATION_HELPER_HPP
@@ -0,0 +1,40 @@
+#include "pulse_decoder.hpp"
+
+PulseDecoder::PulseDecoder()
+    : cyclesPerUs(240),
+      inPulse(false),
+      fallCycles(0),
+      lastToken(0),
+      lastWidth(0) {
+}
+
+void PulseDecoder::begin(uint32_t cyclesPerUs) {
+    this->cyclesPerUs = cyclesPerUs > 0 ? cyclesPerUs : 1;
+    reset();
+}
+
+void PulseDecoder::reset() {
+    inPulse = false;
+}
+
+bool PulseDecoder::push(const PinEdge& edge) {
+    if (edge.level == LOW) {
+        inPulse = true;
+        fallCycles = edge.cycles;
+        return false;
+    }
+    if (!inPulse) {
+        return false;
+    }
+    inPulse = false;
+
+    // Unsigned difference survives the counter wrapping
+    const uint32_t width = (edge.cycles - fallCycles) / cyclesPerUs;
+    if (width < SERIAL_TOKEN_MIN_US) {
+        return false;
+    }
+    const uint32_t units = (width + SERIAL_TOKEN_UNIT_US / 2) / SERIAL_TOKEN_UNIT_US;
+    lastToken = units == 0 ? 0 : (uint8_t)min(units - 1, (uint32_t)255);
+    lastWidth = width;
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef PULSE_DECODER_HPP
+#define PULSE_DECODER_HPP
+
+#include <Arduino.h>
+#include "defines.hpp"
+
+/**
+ * @brief One captured pin edge
+ * 
+ * cycles is the CPU cycle counter of the core running the ISR; only
+ * differences between edges of the same pin are meaningful.
+ */
+struct PinEdge {
+    uint32_t cycles;
+    uint8_t level;
+};
+
+/**
+ * @brief Turns LOW pulses on the chain line into tokens
+ * 
+ * A pulse of (n + 1) * SERIAL_TOKEN_UNIT_US is token n, so the plain
+ * enumeration pulse of BUS_CHAIN_PULSE_US is token 0. Pulses shorter than
+ * SERIAL_TOKEN_MIN_US are treated as glitches.
+ */
+class PulseDecoder {
+public:
+    PulseDecoder();
+
+    /**
+     * @brief Set the cycle counter rate
+     * @param cyclesPerUs CPU clock in MHz
+     */
+    void begin(uint32_t cyclesPerUs);
+
+    /**
+     * @brief Forget a pulse in progress
+     */
+    void reset();
+
+    /**
+     * @brief Feed the next edge
+     * @return true if it ended a pulse; see token() and width()
+     */
+    bool push(const PinEdge& edge);
+
+    uint8_t token() const { return lastToken; }
+    uint32_t width() const { return lastWidth; }
+
+private:
+    uint32_t cyclesPerUs;
+    bool inPulse;
+    uint32_t fallCycles;
+    uint8_t lastToken;
+    uint32_t lastWidth;
+};
+
+#endif // PULSE_DECODER_HPP
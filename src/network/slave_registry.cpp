@@ -0,0 +1,87 @@
+#include "slave_registry.hpp"
+
+constexpr uint16_t SlaveRegistry::INDEX_SIZE;
+constexpr uint32_t SlaveRegistry::CHAIN_SEED;
+
+SlaveRegistry::SlaveRegistry() {
+    clear();
+}
+
+void SlaveRegistry::clear() {
+    memset(index, 0, sizeof(index));
+    count = 0;
+}
+
+uint32_t SlaveRegistry::chainHash(uint32_t upstream, const uint8_t* mac) {
+    uint32_t h = upstream;
+    for (int i = 0; i < 6; i++) {
+        h = (h ^ mac[i]) * 16777619u;
+    }
+    return h;
+}
+
+uint32_t SlaveRegistry::fingerprint() const {
+    uint32_t h = CHAIN_SEED;
+    for (uint8_t i = 0; i < count; i++) {
+        h = chainHash(h, entries[i].mac);
+    }
+    return h;
+}
+
+uint16_t SlaveRegistry::hash(const uint8_t* mac) {
+    // The vendor prefix is usually shared, all bytes still count
+    const uint32_t h = chainHash(CHAIN_SEED, mac);
+    return (uint16_t)((h ^ (h >> 16)) & (INDEX_SIZE - 1));
+}
+
+uint16_t SlaveRegistry::locate(const uint8_t* mac) const {
+    uint16_t slot = hash(mac);
+    while (index[slot] != 0 && memcmp(entries[index[slot] - 1].mac, mac, 6) != 0) {
+        slot = (slot + 1) & (INDEX_SIZE - 1);
+    }
+    return slot;
+}
+
+int SlaveRegistry::find(const uint8_t* mac) const {
+    const uint16_t slot = locate(mac);
+    return index[slot] != 0 ? entries[index[slot] - 1].address : -1;
+}
+
+int SlaveRegistry::add(const uint8_t* mac) {
+    const uint16_t slot = locate(mac);
+    if (index[slot] != 0) {
+        return entries[index[slot] - 1].address;
+    }
+    if (count >= MAX_SLAVES) {
+        return -1;
+    }
+
+    SlaveEntry& entry = entries[count];
+    memcpy(entry.mac, mac, sizeof(entry.mac));
+    entry.address = count;
+    entry.flags = SLAVE_ONLINE;
+    entry.groups = 0;
+    index[slot] = count + 1;
+    count++;
+    return entry.address;
+}
+
+void SlaveRegistry::truncate(uint8_t size) {
+    if (size >= count) {
+        return;
+    }
+    // Linear probing cannot delete in place, rebuild the index instead
+    memset(index, 0, sizeof(index));
+    count = size;
+    for (uint8_t i = 0; i < count; i++) {
+        index[locate(entries[i].mac)] = i + 1;
+    }
+}
+
+SlaveEntry* SlaveRegistry::get(uint8_t address) {
+    return address < count ? &entries[address] : nullptr;
+}
+
+const SlaveEntry* SlaveRegistry::get(uint8_t address) const {
+    return address < count ? &entries[address] : nullptr;
+}
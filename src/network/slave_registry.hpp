@@ -0,0 +1,113 @@
+#ifndef SLAVE_REGISTRY_HPP
+#define SLAVE_REGISTRY_HPP
+
+#include <Arduino.h>
+#include "defines.hpp"
+
+static_assert(MAX_SLAVES > 0 && MAX_SLAVES < BUS_ADDR_UNASSIGNED,
+              "slave addresses must stay below the reserved bus addresses");
+
+/**
+ * @brief Status flags of a registered slave
+ */
+enum SlaveFlags : uint8_t {
+    SLAVE_ONLINE    = 0x01,  ///< Answered during the last enumeration or poll
+    SLAVE_ATTENTION = 0x02,  ///< Has raised an attention request
+    SLAVE_FAULT     = 0x04   ///< Reported an error condition
+};
+
+/**
+ * @brief One registered slave, 9 bytes
+ */
+struct SlaveEntry {
+    uint8_t mac[6];
+    uint8_t address;
+    uint8_t flags;
+    uint8_t groups;     ///< Multicast groups confirmed by the slave
+};
+
+// Power of two of at least twice the given slave count
+constexpr uint16_t slaveIndexSize(uint16_t size) {
+    return size >= 2 * MAX_SLAVES ? size : slaveIndexSize(size * 2);
+}
+
+/**
+ * @brief Compact table of enumerated slaves
+ * 
+ * Entries are stored by bus address (the order of the chain), so lookup by
+ * address is an array index. A MAC lookup goes through an open-addressed
+ * hash index with linear probing, sized to a power of two at least twice
+ * MAX_SLAVES so probe sequences stay short.
+ * 
+ * Capacity is MAX_SLAVES; add() rejects further slaves instead of
+ * overwriting memory.
+ */
+class SlaveRegistry {
+public:
+    SlaveRegistry();
+
+    /**
+     * @brief Forget all slaves (before re-enumeration)
+     */
+    void clear();
+
+    /**
+     * @brief Register a slave under the next free address
+     * @param mac 6-byte MAC address
+     * @return Assigned address, the existing address if the MAC is already
+     *         registered, or -1 if the registry is full
+     */
+    int add(const uint8_t* mac);
+
+    /**
+     * @brief Look up the address of a MAC
+     * @return Address or -1 if unknown
+     */
+    int find(const uint8_t* mac) const;
+
+    /**
+     * @brief Entry of a bus address, nullptr if unassigned
+     */
+    SlaveEntry* get(uint8_t address);
+    const SlaveEntry* get(uint8_t address) const;
+
+    /**
+     * @brief Forget the slaves from address size on
+     */
+    void truncate(uint8_t size);
+
+    uint8_t size() const { return count; }
+    uint8_t capacity() const { return MAX_SLAVES; }
+
+    /**
+     * @brief Topology fingerprint: chainHash() over all MACs in chain order
+     */
+    uint32_t fingerprint() const;
+
+    /**
+     * @brief Extend a chain hash by one slave (FNV-1a over the MAC)
+     * 
+     * The hash of slave n covers the MACs of slaves 0..n, so comparing it
+     * at one position checks the whole chain up to there.
+     */
+    static uint32_t chainHash(uint32_t upstream, const uint8_t* mac);
+
+    static constexpr uint32_t CHAIN_SEED = 2166136261u;
+
+private:
+    // Smallest power of two holding MAX_SLAVES at a load factor of 1/2
+    static constexpr uint16_t INDEX_SIZE = slaveIndexSize(1);
+
+    static uint16_t hash(const uint8_t* mac);
+
+    /**
+     * @brief Index slot holding mac, or the empty slot where it belongs
+     */
+    uint16_t locate(const uint8_t* mac) const;
+
+    SlaveEntry entries[MAX_SLAVES];
+    uint8_t index[INDEX_SIZE];    // address + 1, 0 marks an empty slot
+    uint8_t count;
+};
+
+#endif // SLAVE_REGISTRY_HPP
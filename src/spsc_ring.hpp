@@ -0,0 +1,74 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Lock-free single-producer/single-consumer ring buffer
+ * 
+ * One task (or ISR) pushes, one other task pops. Head and tail are only
+ * written by their owner, so neither side ever blocks or disables
+ * interrupts. Holds up to N items; N must be a power of two.
+ * 
+ * @tparam T Trivially copyable item type
+ * @tparam N Capacity
+ */
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    /**
+     * @brief Append an item (producer side)
+     * @return false if the ring is full
+     */
+    inline bool push(const T& item) {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the oldest item (consumer side)
+     * @return false if the ring is empty
+     */
+    inline bool pop(T& item) {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t) {
+            return false;
+        }
+        item = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Drop all items (consumer side)
+     */
+    inline void clear() {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    inline bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    inline size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return N; }
+
+private:
+    T items[N];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+};
+
+#endif // SPSC_RING_HPP
@@ -0,0 +1,247 @@
+/*
+ * StaticStepper.h - Stepper with its wiring fixed at compile time
+ *
+ * Same moves as Stepper (blocking step(), moveAsync() on an esp_timer,
+ * acceleration ramps, position tracking) for motors whose pins and drive
+ * mode are known when compiling:
+ *
+ *    StaticStepper<Stepper::HALF_STEP, 32, 33, 25, 26> motor(400);
+ *
+ * The phase sequence, its length and which GPIO banks a wiring uses are
+ * resolved by the compiler; the bank writes it does not need are compiled
+ * out. The GPIO set/clear words of every phase come from the constexpr
+ * mask(), but are filled into RAM tables of the object by the constructor,
+ * so the step path never reads flash and stays usable from the timer
+ * interrupt. Each step is an add, a modulo by a constant, table loads and
+ * at most four register writes, without branching on the pin count or
+ * wrapping a step counter.
+ *
+ * Speed, ramps and the asynchronous move timer are shared with Stepper
+ * through StepMove; only the step itself is specialised here.
+ *
+ * Use Stepper when pins or drive mode are only known at run time, and for
+ * motors driven by StepScheduler.
+ */
+
+#ifndef StaticStepper_h
+#define StaticStepper_h
+
+#include "Arduino.h"
+#include "soc/gpio_struct.h"
+#include "Stepper.h"
+#include "StepMove.h"
+#include "StepPhases.h"
+#include "StepRamp.h"
+
+template <Stepper::DriveMode Mode, int... Pins>
+class StaticStepper {
+  public:
+    typedef Stepper::CompletionCallback CompletionCallback;
+
+    static constexpr int pin_count = sizeof...(Pins);
+    static constexpr int phase_count =
+        pin_count == 5 ? 10 : (Mode == Stepper::HALF_STEP ? 8 : 4);
+
+    static_assert(pin_count == 2 || pin_count == 4 || pin_count == 5,
+                  "StaticStepper drives 2, 4 or 5 wires");
+    static_assert(Mode == Stepper::FULL_STEP || pin_count == 4,
+                  "HALF_STEP and WAVE_DRIVE need four wires");
+
+    // number_of_steps counts half steps in HALF_STEP mode:
+    explicit StaticStepper(int number_of_steps);
+
+    // speed setter method, in revs per minute:
+    void setSpeed(long whatSpeed) { this->motion.setSpeed(this->number_of_steps, whatSpeed); }
+
+    // acceleration setters, applied to every following move:
+    void setAcceleration(long steps_per_s2) { this->motion.setAcceleration(steps_per_s2); }
+    void setProfile(StepRamp::Profile profile) { this->motion.setProfile(profile); }
+
+    // mover method:
+    void step(int number_of_steps);
+
+    // asynchronous mover methods, steps are emitted from an esp_timer:
+    void moveAsync(int number_of_steps);
+    bool isRunning(void) const { return this->motion.isRunning(); }
+    void stop(void) { this->motion.stop(); }
+    void setCompletionCallback(CompletionCallback callback, void *arg)
+    {
+      this->motion.setCompletionCallback(callback, arg);
+    }
+
+    // coil power, the current phase is kept while released:
+    void release(void);
+    void energize(void);
+
+    // absolute position tracking:
+    long currentPosition(void) const { return this->position; }
+    void setCurrentPosition(long position) { this->position = position; }
+    int stepsPerRevolution(void) const { return this->number_of_steps; }
+
+  private:
+    static constexpr int pins[pin_count] = { Pins... };
+
+    // coil bitmask of one phase of the selected sequence:
+    static constexpr uint8_t coils(int index)
+    {
+      return pin_count == 2 ? two_wire_phases[index]
+           : pin_count == 5 ? five_wire_phases[index]
+           : Mode == Stepper::HALF_STEP ? half_step_phases[index]
+           : Mode == Stepper::WAVE_DRIVE ? wave_drive_phases[index]
+           : four_wire_phases[index];
+    }
+
+    // GPIO word of the coils of one phase that are on (or off), for pins
+    // 0-31 (or 32-39):
+    static constexpr uint32_t mask(int index, bool on, bool high, int coil = 0)
+    {
+      return coil == pin_count ? 0
+        : ((((coils(index) >> coil) & 1) == (on ? 1 : 0) && (pins[coil] >= 32) == high)
+             ? 1UL << (pins[coil] & 31) : 0UL) | mask(index, on, high, coil + 1);
+    }
+
+    static constexpr bool usesBank(bool high, int coil = 0)
+    {
+      return coil < pin_count && ((pins[coil] >= 32) == high || usesBank(high, coil + 1));
+    }
+
+    static constexpr bool uses_low_bank = usesBank(false);
+    static constexpr bool uses_high_bank = usesBank(true);
+
+    void stepMotor(int index);
+    void internalStep(void);
+    static void onStepTimer(void *arg);
+
+    int number_of_steps;      // total number of steps this motor can take
+    int delta;                // +1 forward, -1 backward
+    int phase_index;          // current entry of the phase sequence
+    volatile long position;   // absolute position in steps
+
+    uint32_t phase_set_low[phase_count];
+    uint32_t phase_clear_low[phase_count];
+    uint32_t phase_set_high[phase_count];
+    uint32_t phase_clear_high[phase_count];
+
+    // speed, ramp and asynchronous move state:
+    StepMove motion;
+};
+
+template <Stepper::DriveMode Mode, int... Pins>
+constexpr int StaticStepper<Mode, Pins...>::pins[StaticStepper<Mode, Pins...>::pin_count];
+
+template <Stepper::DriveMode Mode, int... Pins>
+StaticStepper<Mode, Pins...>::StaticStepper(int number_of_steps)
+{
+  this->number_of_steps = number_of_steps;
+  this->delta = 1;
+  this->phase_index = 0;
+  this->position = 0;
+
+  // mask() is constexpr, but with the loop index it is evaluated here at
+  // run time, once per object; the masks live in the object (RAM) so the
+  // step path never reads flash and stays usable from the timer interrupt:
+  for (int index = 0; index < phase_count; index++)
+  {
+    this->phase_set_low[index] = mask(index, true, false);
+    this->phase_clear_low[index] = mask(index, false, false);
+    this->phase_set_high[index] = mask(index, true, true);
+    this->phase_clear_high[index] = mask(index, false, true);
+  }
+
+  const int wiring[pin_count] = { Pins... };
+  for (int coil = 0; coil < pin_count; coil++)
+    pinMode(wiring[coil], OUTPUT);
+}
+
+/*
+ * Moves the motor steps_to_move steps, waiting with vTaskDelay() between
+ * steps like Stepper::step().
+ */
+template <Stepper::DriveMode Mode, int... Pins>
+void StaticStepper<Mode, Pins...>::step(int steps_to_move)
+{
+  const int steps_total = abs(steps_to_move);
+  this->delta = steps_to_move < 0 ? -1 : 1;
+
+  for (int steps_done = 0; steps_done < steps_total; steps_done++)
+  {
+    unsigned long now;
+    this->motion.waitForStep(steps_done, steps_total, now);
+    internalStep();
+  }
+}
+
+/*
+ * Starts moving steps_to_move steps and returns immediately, see
+ * Stepper::moveAsync().
+ */
+template <Stepper::DriveMode Mode, int... Pins>
+void StaticStepper<Mode, Pins...>::moveAsync(int steps_to_move)
+{
+  if (!this->motion.takeTimer(&StaticStepper::onStepTimer, this))
+    return;
+
+  if (steps_to_move == 0)
+    return;
+
+  this->delta = steps_to_move < 0 ? -1 : 1;
+  this->motion.armTimer(this->motion.start(steps_to_move));
+}
+
+template <Stepper::DriveMode Mode, int... Pins>
+void IRAM_ATTR StaticStepper<Mode, Pins...>::onStepTimer(void *arg)
+{
+  StaticStepper *stepper = (StaticStepper *)arg;
+
+  unsigned long now, interval;
+  if (stepper->motion.nextStep(now, interval))
+    stepper->internalStep();
+
+  unsigned long next_delay;
+  if (stepper->motion.advance(next_delay))
+    stepper->motion.rearmTimer(next_delay);
+}
+
+/*
+ * One step in the current direction. phase_count is a constant, so the
+ * modulo compiles to a mask or a multiply.
+ */
+template <Stepper::DriveMode Mode, int... Pins>
+inline void IRAM_ATTR StaticStepper<Mode, Pins...>::internalStep(void)
+{
+  this->position += this->delta;
+  this->phase_index = (this->phase_index + phase_count + this->delta) % phase_count;
+  stepMotor(this->phase_index);
+}
+
+template <Stepper::DriveMode Mode, int... Pins>
+inline void IRAM_ATTR StaticStepper<Mode, Pins...>::stepMotor(int index)
+{
+  if (uses_low_bank)
+  {
+    GPIO.out_w1ts = this->phase_set_low[index];
+    GPIO.out_w1tc = this->phase_clear_low[index];
+  }
+  if (uses_high_bank)
+  {
+    GPIO.out1_w1ts.val = this->phase_set_high[index];
+    GPIO.out1_w1tc.val = this->phase_clear_high[index];
+  }
+}
+
+template <Stepper::DriveMode Mode, int... Pins>
+void IRAM_ATTR StaticStepper<Mode, Pins...>::release(void)
+{
+  if (uses_low_bank)
+    GPIO.out_w1tc = this->phase_set_low[0] | this->phase_clear_low[0];
+  if (uses_high_bank)
+    GPIO.out1_w1tc.val = this->phase_set_high[0] | this->phase_clear_high[0];
+}
+
+template <Stepper::DriveMode Mode, int... Pins>
+void IRAM_ATTR StaticStepper<Mode, Pins...>::energize(void)
+{
+  stepMotor(this->phase_index);
+}
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * StepMove.cpp - Move timing shared by Stepper and StaticStepper
+ */
+
+#include "Arduino.h"
+#include "StepMove.h"
+
+/*
+ * esp_timer callbacks run from the esp_timer task by default. When the
+ * sdkconfig allows ISR dispatch, steps are emitted straight from the timer
+ * interrupt instead; the functions the callback reaches here are IRAM_ATTR
+ * like the owners' step code.
+ */
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+#define STEP_MOVE_TIMER_DISPATCH ESP_TIMER_ISR
+#else
+#define STEP_MOVE_TIMER_DISPATCH ESP_TIMER_TASK
+#endif
+
+StepMove::StepMove()
+{
+  this->step_delay = 0;     // no speed set yet
+  this->last_step_time = 0;
+  this->profile = StepRamp::CONSTANT; // no acceleration ramp by default
+  this->acceleration = 0;
+
+  // asynchronous move state, the timer is created lazily:
+  this->step_timer = NULL;
+  this->steps_total = 0;
+  this->steps_left = 0;
+  this->running = false;
+  this->stop_requested = false;
+  this->next_step_deadline = 0;
+  this->completion_callback = NULL;
+  this->completion_arg = NULL;
+}
+
+void StepMove::setSpeed(int steps_per_revolution, long rpm)
+{
+  this->step_delay = 60L * 1000L * 1000L / steps_per_revolution / rpm;
+  this->ramp.configure(this->profile, this->step_delay, this->acceleration);
+}
+
+/*
+ * Sets the acceleration in steps per second squared. Has no effect with
+ * the CONSTANT profile.
+ */
+void StepMove::setAcceleration(long steps_per_s2)
+{
+  this->acceleration = steps_per_s2;
+  this->ramp.configure(this->profile, this->step_delay, this->acceleration);
+}
+
+/*
+ * Selects the acceleration profile: CONSTANT, TRAPEZOID or S_CURVE.
+ */
+void StepMove::setProfile(StepRamp::Profile profile)
+{
+  this->profile = profile;
+  this->ramp.configure(this->profile, this->step_delay, this->acceleration);
+}
+
+/*
+ * RTOS friendly wait for the next step of a blocking move: sleeps whole
+ * ticks while the step is at least a tick away, yields otherwise.
+ */
+unsigned long StepMove::waitForStep(int steps_done, int steps_total, unsigned long &now)
+{
+  for (;;)
+  {
+    now = micros();
+    const uint32_t elapsed = (uint32_t)(now - this->last_step_time);
+    const unsigned long delay = this->ramp.interval(steps_done, steps_total - steps_done - 1);
+
+    // step only if the appropriate delay has passed:
+    if (elapsed >= delay)
+    {
+      this->last_step_time = now;
+      return steps_done == 0 ? 0 : delay;
+    }
+
+    // delay is in us, FreeRTOS delays in ticks/ms
+    const uint32_t remaining_us = (uint32_t)(delay - elapsed);
+    const TickType_t ticks = pdMS_TO_TICKS((remaining_us + 999) / 1000); // round up
+
+    if (ticks > 0)
+      vTaskDelay(ticks);
+    else
+      taskYIELD(); // remaining < 1 tick -> at least yield CPU
+  }
+}
+
+/*
+ * Prepares an asynchronous move of number_of_steps steps (the sign is the
+ * owner's business) and returns the delay in us before its first step.
+ */
+unsigned long StepMove::start(int number_of_steps)
+{
+  this->steps_total = abs(number_of_steps);
+  this->steps_left = this->steps_total;
+  this->stop_requested = false;
+  this->running = this->steps_left > 0;
+
+  // honour the first delay since the last step:
+  const uint32_t elapsed = (uint32_t)(micros() - this->last_step_time);
+  const unsigned long delay = this->ramp.interval(0, this->steps_total - 1);
+  return elapsed >= delay ? 0 : delay - elapsed;
+}
+
+/*
+ * Books the next step of the asynchronous move. Returns false if the move
+ * is over or being stopped; otherwise the owner drives the coils for a step
+ * taken at now, interval is the commanded time since the previous one.
+ */
+bool IRAM_ATTR StepMove::nextStep(unsigned long &now, unsigned long &interval)
+{
+  const int steps_left = this->steps_left;
+  if (this->stop_requested || steps_left <= 0)
+    return false;
+
+  const int steps_done = this->steps_total - steps_left;
+  interval = steps_done == 0 ? 0 : this->ramp.interval(steps_done, steps_left - 1);
+  now = micros();
+  this->last_step_time = now;
+  this->steps_left = steps_left - 1;
+  return true;
+}
+
+/*
+ * Called after nextStep(). Returns true and the delay until the following
+ * step in next_delay while the move goes on, or false once it has finished
+ * (the completion callback has then run).
+ */
+bool IRAM_ATTR StepMove::advance(unsigned long &next_delay)
+{
+  const int steps_left = this->steps_left;
+  if (this->stop_requested || steps_left == 0)
+  {
+    finish();
+    return false;
+  }
+
+  next_delay = this->ramp.interval(this->steps_total - steps_left, steps_left - 1);
+  return true;
+}
+
+/*
+ * Ends an asynchronous move after the current step. The completion
+ * callback is still invoked.
+ */
+void StepMove::stop(void)
+{
+  if (!this->running)
+    return;
+
+  this->stop_requested = true;
+  if (this->step_timer != NULL && esp_timer_stop(this->step_timer) == ESP_OK)
+  {
+    // the timer was pending, so no callback will run to finish the move:
+    finish();
+  }
+}
+
+void StepMove::setCompletionCallback(CompletionCallback callback, void *arg)
+{
+  this->completion_callback = callback;
+  this->completion_arg = arg;
+}
+
+/*
+ * Creates the step timer on first use and cancels whatever it still has
+ * pending; a move cancelled that way ends like a stopped one. Returns false
+ * if the timer could not be created.
+ */
+bool StepMove::takeTimer(esp_timer_cb_t callback, void *arg)
+{
+  if (this->step_timer == NULL)
+  {
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = callback;
+    timer_args.arg = arg;
+    timer_args.dispatch_method = STEP_MOVE_TIMER_DISPATCH;
+    timer_args.name = "stepper";
+    if (esp_timer_create(&timer_args, &this->step_timer) != ESP_OK)
+    {
+      this->step_timer = NULL;
+      return false;
+    }
+  }
+
+  if (esp_timer_stop(this->step_timer) == ESP_OK && this->running)
+  {
+    // the replaced move gets no more callbacks, report it as ended here:
+    finish();
+  }
+  return true;
+}
+
+/*
+ * Fires the timer after wait us; the move runs on absolute deadlines from
+ * here on.
+ */
+void StepMove::armTimer(unsigned long wait)
+{
+  this->next_step_deadline = esp_timer_get_time() + wait;
+  esp_timer_start_once(this->step_timer, wait);
+}
+
+/*
+ * Re-arms the timer from the timer callback. Deadlines are absolute so that
+ * callback latency does not accumulate over a move.
+ */
+void IRAM_ATTR StepMove::rearmTimer(unsigned long next_delay)
+{
+  this->next_step_deadline += next_delay;
+  const int64_t wait = this->next_step_deadline - esp_timer_get_time();
+  esp_timer_start_once(this->step_timer, wait > 0 ? (uint64_t)wait : 0);
+}
+
+/*
+ * Marks the asynchronous move as done and notifies the owner.
+ */
+void IRAM_ATTR StepMove::finish(void)
+{
+  this->steps_left = 0;
+  this->running = false;
+  if (this->completion_callback != NULL)
+    this->completion_callback(this->completion_arg);
+}
@@ -0,0 +1,83 @@
+/*
+ * StepMove.h - Move timing shared by Stepper and StaticStepper
+ *
+ * Owns everything about a move that does not depend on the wiring: the
+ * speed and acceleration ramp, the blocking wait between steps, the state
+ * of an asynchronous move and its esp_timer with absolute deadlines. The
+ * owner only turns "take a step now" into coil outputs:
+ *
+ *    blocking:      for each step, waitForStep() then drive the coils
+ *    asynchronous:  takeTimer(), start(), armTimer(); in the timer callback
+ *                   nextStep() and drive the coils if it returns true, then
+ *                   advance() and rearmTimer() while it returns true
+ *
+ * No virtual calls, so the timer path stays in IRAM together with the
+ * owner's step code.
+ */
+
+#ifndef StepMove_h
+#define StepMove_h
+
+#include "esp_timer.h"
+#include "StepRamp.h"
+
+class StepMove {
+  public:
+    // completion callback for asynchronous moves, called from timer context,
+    // which is the timer interrupt with ISR dispatch: mark it IRAM_ATTR and
+    // keep it ISR-safe:
+    typedef void (*CompletionCallback)(void *arg);
+
+    StepMove();
+
+    // speed in revs per minute of a motor with steps_per_revolution steps:
+    void setSpeed(int steps_per_revolution, long rpm);
+
+    // acceleration setters, applied to every following move:
+    void setAcceleration(long steps_per_s2);
+    void setProfile(StepRamp::Profile profile);
+
+    // blocking moves: waits until step steps_done of steps_total is due and
+    // returns its commanded interval (0 for the first step) and time stamp:
+    unsigned long waitForStep(int steps_done, int steps_total, unsigned long &now);
+
+    // asynchronous moves, see the sequence above:
+    unsigned long start(int number_of_steps);
+    bool nextStep(unsigned long &now, unsigned long &interval);
+    bool advance(unsigned long &next_delay);
+    bool isRunning(void) const { return this->running; }
+    void stop(void);
+
+    // ISR-safe part of stop(): no further step is taken, the move ends on
+    // its next deadline:
+    void requestStop(void) { if (this->running) this->stop_requested = true; }
+    void setCompletionCallback(CompletionCallback callback, void *arg);
+
+    // step timer, created on first use:
+    bool takeTimer(esp_timer_cb_t callback, void *arg);
+    void armTimer(unsigned long wait);
+    void rearmTimer(unsigned long next_delay);
+
+  private:
+    void finish(void);
+
+    unsigned long step_delay;     // cruise delay between steps, in us
+    unsigned long last_step_time; // time stamp in us of when the last step was taken
+
+    // acceleration ramp, rebuilt whenever speed, acceleration or profile change:
+    StepRamp ramp;
+    StepRamp::Profile profile;
+    long acceleration;            // in steps/s^2
+
+    // asynchronous move state, shared with the step timer callback:
+    esp_timer_handle_t step_timer;     // created by the first takeTimer()
+    int steps_total;                   // length of the current move
+    volatile int steps_left;           // steps remaining in the current move
+    volatile bool running;             // true while a move is in progress
+    volatile bool stop_requested;      // set by stop() to end the move early
+    int64_t next_step_deadline;        // esp_timer time of the next step, in us
+    CompletionCallback completion_callback;
+    void *completion_arg;
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * StepPhases.h - Phase sequences of the Stepper library
+ *
+ * Coil bitmasks of every supported phase sequence, see the tables in
+ * Stepper.h. Shared by Stepper and StaticStepper; everything here is
+ * constexpr so StaticStepper can resolve its GPIO masks at compile time.
+ */
+
+#ifndef StepPhases_h
+#define StepPhases_h
+
+#include <stdint.h>
+
+/*
+ * Converts one row of the sequence tables in Stepper.h (C0 first) into a
+ * coil bitmask, bit n drives motor_pin_(n + 1).
+ */
+static constexpr uint8_t phase(const char *row, int coil = 0)
+{
+  return row[coil] == '\0' ? 0
+    : (uint8_t)(((row[coil] == '1' ? 1 : 0) << coil) | phase(row, coil + 1));
+}
+
+static constexpr uint8_t two_wire_phases[4] = {
+  phase("01"), phase("11"), phase("10"), phase("00")
+};
+
+static constexpr uint8_t four_wire_phases[4] = {
+  phase("1010"), phase("0110"), phase("0101"), phase("1001")
+};
+
+static constexpr uint8_t half_step_phases[8] = {
+  phase("1010"), phase("0010"), phase("0110"), phase("0100"),
+  phase("0101"), phase("0001"), phase("1001"), phase("1000")
+};
+
+static constexpr uint8_t wave_drive_phases[4] = {
+  phase("0010"), phase("0100"), phase("0001"), phase("1000")
+};
+
+static constexpr uint8_t five_wire_phases[10] = {
+  phase("01101"), phase("01001"), phase("01011"), phase("01010"), phase("11010"),
+  phase("10010"), phase("10110"), phase("10100"), phase("10101"), phase("00101")
+};
+
+static_assert(four_wire_phases[0] == 0x05 && five_wire_phases[9] == 0x14,
+              "phase rows are read C0 first");
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * StepRamp.cpp - Precomputed acceleration ramps for the Stepper library
+ *
+ * See StepRamp.h for the table layout.
+ */
+
+#include <math.h>
+#include "StepRamp.h"
+
+StepRamp::StepRamp()
+{
+  this->length = 0;
+  this->cruise_delay = 0;
+}
+
+/*
+ * Rebuilds the ramp for the given profile. Must not be called while a move
+ * using this ramp is running.
+ */
+void StepRamp::configure(Profile profile, unsigned long cruise_delay, long acceleration)
+{
+  this->cruise_delay = cruise_delay;
+  this->length = 0;
+
+  if (profile == CONSTANT || acceleration <= 0 || cruise_delay == 0)
+    return;
+
+  if (profile == TRAPEZOID)
+    buildTrapezoid(acceleration);
+  else
+    buildSCurve(acceleration);
+
+  // the ramp was cut short by the table size, cruise at its final speed
+  // instead of jumping to the requested one:
+  if (this->length == STEPPER_RAMP_TABLE_SIZE &&
+      this->table[this->length - 1] > this->cruise_delay)
+    this->cruise_delay = this->table[this->length - 1];
+}
+
+/*
+ * Constant acceleration from standstill: step k is reached at
+ * t(k) = sqrt(2k / a).
+ */
+void StepRamp::buildTrapezoid(long acceleration)
+{
+  const double a = (double)acceleration;
+  double t_prev = 0.0;
+
+  while (this->length < STEPPER_RAMP_TABLE_SIZE)
+  {
+    const double t_next = sqrt(2.0 * (this->length + 1) / a);
+    const double interval = (t_next - t_prev) * 1e6;
+    if (interval <= (double)this->cruise_delay)
+      break;
+
+    this->table[this->length++] = (uint32_t)(interval + 0.5);
+    t_prev = t_next;
+  }
+}
+
+/*
+ * Jerk-limited acceleration: velocity follows v(u) = v_max * (3u^2 - 2u^3)
+ * over the ramp time T = v_max / a, so position is
+ * p(u) = v_max * T * (u^3 - u^4 / 2). The time of each step is found by
+ * bisection on p(u) = k.
+ */
+void StepRamp::buildSCurve(long acceleration)
+{
+  const double v_max = 1e6 / (double)this->cruise_delay;
+  const double ramp_time = v_max / (double)acceleration;
+  const double ramp_distance = v_max * ramp_time / 2.0;
+  double t_prev = 0.0;
+
+  while (this->length < STEPPER_RAMP_TABLE_SIZE && this->length + 1 <= ramp_distance)
+  {
+    const double target = (double)(this->length + 1);
+    double lo = 0.0;
+    double hi = 1.0;
+    for (int i = 0; i < 40; i++)
+    {
+      const double u = (lo + hi) / 2.0;
+      const double p = v_max * ramp_time * (u * u * u - u * u * u * u / 2.0);
+      if (p < target)
+        lo = u;
+      else
+        hi = u;
+    }
+
+    const double t_next = hi * ramp_time;
+    const double interval = (t_next - t_prev) * 1e6;
+    if (interval <= (double)this->cruise_delay)
+      break;
+
+    this->table[this->length++] = (uint32_t)(interval + 0.5);
+    t_prev = t_next;
+  }
+}
@@ -0,0 +1,68 @@
+/*
+ * StepRamp.h - Precomputed acceleration ramps for the Stepper library
+ *
+ * A ramp holds the step intervals (in us) of the acceleration phase of a
+ * move. The deceleration phase replays the same table backwards, so a move
+ * of n steps uses
+ *
+ *    interval(i) = table[min(i, n - 1 - i)]   while inside the table
+ *    interval(i) = cruise_delay               otherwise
+ *
+ * All floating point work happens in configure(); the per-step lookup is a
+ * comparison and an array index, cheap enough for the step timer callback.
+ *
+ * Profiles:
+ *   CONSTANT   no ramp, every step uses the cruise delay
+ *   TRAPEZOID  constant acceleration up to cruise speed
+ *   S_CURVE    jerk-limited acceleration (smoothstep velocity curve) with
+ *              the same average acceleration as TRAPEZOID
+ */
+
+#ifndef StepRamp_h
+#define StepRamp_h
+
+#include <stdint.h>
+
+// maximum number of ramp steps, longer ramps lower the cruise speed:
+#ifndef STEPPER_RAMP_TABLE_SIZE
+#define STEPPER_RAMP_TABLE_SIZE 512
+#endif
+
+class StepRamp {
+  public:
+    enum Profile {
+      CONSTANT,
+      TRAPEZOID,
+      S_CURVE
+    };
+
+    StepRamp();
+
+    // rebuilds the table, acceleration is given in steps/s^2:
+    void configure(Profile profile, unsigned long cruise_delay, long acceleration);
+
+    // delay in us before the step that has steps_done steps before it and
+    // steps_after steps after it within the current move; always inlined so
+    // the IRAM step timer path never calls into flash:
+    inline __attribute__((always_inline)) unsigned long interval(int steps_done, int steps_after) const
+    {
+      const int k = steps_done < steps_after ? steps_done : steps_after;
+      return k < this->length ? this->table[k] : this->cruise_delay;
+    }
+
+    // cruise delay actually reached, may be longer than requested when the
+    // ramp did not fit into the table:
+    unsigned long cruiseDelay(void) const { return this->cruise_delay; }
+
+    int rampSteps(void) const { return this->length; }
+
+  private:
+    void buildTrapezoid(long acceleration);
+    void buildSCurve(long acceleration);
+
+    uint32_t table[STEPPER_RAMP_TABLE_SIZE];
+    int length;                  // number of valid table entries
+    unsigned long cruise_delay;  // step delay after the ramp, in us
+};
+
+#endif
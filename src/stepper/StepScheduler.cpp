@@ -0,0 +1,260 @@
+/*
+ * StepScheduler.cpp - Concurrent stepping of several Stepper instances
+ *
+ * See StepScheduler.h for an overview.
+ */
+
+#include "Arduino.h"
+#include "StepScheduler.h"
+
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+#define STEP_SCHEDULER_DISPATCH ESP_TIMER_ISR
+#else
+#define STEP_SCHEDULER_DISPATCH ESP_TIMER_TASK
+#endif
+
+StepScheduler::StepScheduler()
+{
+  this->axis_count = 0;
+  this->heap_size = 0;
+  this->timer = NULL;
+  this->lock = portMUX_INITIALIZER_UNLOCKED;
+  for (int i = 0; i < STEP_SCHEDULER_MAX_AXES; i++)
+  {
+    this->axes[i] = NULL;
+    this->heap_index[i] = -1;
+    this->stepping[i] = false;
+    this->deferred[i] = false;
+    this->deferred_steps[i] = 0;
+  }
+}
+
+int StepScheduler::addAxis(Stepper *stepper)
+{
+  if (stepper == NULL || this->axis_count >= STEP_SCHEDULER_MAX_AXES)
+    return -1;
+
+  // the timer is created lazily, esp_timer is not up during static init:
+  if (this->timer == NULL)
+  {
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = &StepScheduler::onTimer;
+    timer_args.arg = this;
+    timer_args.dispatch_method = STEP_SCHEDULER_DISPATCH;
+    timer_args.name = "step_sched";
+    if (esp_timer_create(&timer_args, &this->timer) != ESP_OK)
+    {
+      this->timer = NULL;
+      return -1;
+    }
+  }
+
+  this->axes[this->axis_count] = stepper;
+  return this->axis_count++;
+}
+
+bool StepScheduler::move(int axis, int number_of_steps)
+{
+  if (axis < 0 || axis >= this->axis_count)
+    return false;
+
+  Stepper *stepper = this->axes[axis];
+
+  portENTER_CRITICAL(&this->lock);
+  if (this->stepping[axis] || this->heap_index[axis] >= 0)
+  {
+    // a move is running: service() ends it, so its completion callback runs,
+    // and starts this one after it
+    this->deferred[axis] = true;
+    this->deferred_steps[axis] = number_of_steps;
+    if (!this->stepping[axis])
+    {
+      stepper->stop();
+      remove((uint8_t)axis);
+      push((uint8_t)axis, esp_timer_get_time());
+      arm();
+    }
+    portEXIT_CRITICAL(&this->lock);
+    return true;
+  }
+
+  remove((uint8_t)axis);
+  if (number_of_steps != 0)
+  {
+    const unsigned long wait = stepper->startMove(number_of_steps);
+    push((uint8_t)axis, esp_timer_get_time() + wait);
+  }
+  arm();
+  portEXIT_CRITICAL(&this->lock);
+  return true;
+}
+
+void StepScheduler::stop(int axis)
+{
+  if (axis < 0 || axis >= this->axis_count)
+    return;
+
+  // the axis finishes on its next deadline and runs its completion callback:
+  this->axes[axis]->stop();
+}
+
+bool StepScheduler::isRunning(int axis) const
+{
+  if (axis < 0 || axis >= this->axis_count)
+    return false;
+  return this->axes[axis]->isRunning();
+}
+
+bool StepScheduler::isIdle(void) const
+{
+  for (int i = 0; i < this->axis_count; i++)
+  {
+    if (this->axes[i]->isRunning())
+      return false;
+  }
+  return true;
+}
+
+/*
+ * Steps every axis whose deadline has passed and re-arms the timer for the
+ * earliest remaining deadline. Steppers advance outside the lock so their
+ * completion callbacks may start new moves; due axes are marked as stepping
+ * meanwhile, and move() leaves a new move for them to be started here once
+ * the current one has ended.
+ */
+void IRAM_ATTR StepScheduler::service(void)
+{
+  Deadline due[STEP_SCHEDULER_MAX_AXES];
+  int due_count = 0;
+
+  portENTER_CRITICAL(&this->lock);
+  const int64_t now = esp_timer_get_time();
+  while (this->heap_size > 0 && this->heap[0].time <= now)
+  {
+    due[due_count++] = this->heap[0];
+    this->stepping[this->heap[0].axis] = true;
+    remove(this->heap[0].axis);
+  }
+  portEXIT_CRITICAL(&this->lock);
+
+  for (int i = 0; i < due_count; i++)
+  {
+    const uint8_t axis = due[i].axis;
+    Stepper *stepper = this->axes[axis];
+    unsigned long next_delay;
+    const bool running = stepper->advance(next_delay);
+
+    portENTER_CRITICAL(&this->lock);
+    this->stepping[axis] = false;
+    if (this->deferred[axis] && running)
+    {
+      // end the current move on the next pass before starting the new one:
+      stepper->stop();
+      push(axis, esp_timer_get_time());
+    }
+    else if (this->deferred[axis])
+    {
+      // a move() from a completion callback or another task follows this one:
+      this->deferred[axis] = false;
+      if (this->deferred_steps[axis] != 0)
+      {
+        const unsigned long wait = stepper->startMove(this->deferred_steps[axis]);
+        push(axis, esp_timer_get_time() + wait);
+      }
+    }
+    else if (running)
+    {
+      push(axis, due[i].time + next_delay);
+    }
+    portEXIT_CRITICAL(&this->lock);
+  }
+
+  portENTER_CRITICAL(&this->lock);
+  arm();
+  portEXIT_CRITICAL(&this->lock);
+}
+
+void IRAM_ATTR StepScheduler::onTimer(void *arg)
+{
+  ((StepScheduler *)arg)->service();
+}
+
+/*
+ * (Re-)arms the timer for the top of the heap. Caller holds the lock.
+ */
+void IRAM_ATTR StepScheduler::arm(void)
+{
+  esp_timer_stop(this->timer);
+  if (this->heap_size == 0)
+    return;
+
+  const int64_t wait = this->heap[0].time - esp_timer_get_time();
+  esp_timer_start_once(this->timer, wait > 0 ? (uint64_t)wait : 0);
+}
+
+// ============================================================================
+// Deadline min-heap, all callers hold the lock
+// ============================================================================
+
+void IRAM_ATTR StepScheduler::push(uint8_t axis, int64_t time)
+{
+  Deadline entry = { time, axis };
+  place(this->heap_size++, entry);
+  siftUp(this->heap_size - 1);
+}
+
+void IRAM_ATTR StepScheduler::remove(uint8_t axis)
+{
+  const int index = this->heap_index[axis];
+  if (index < 0)
+    return;
+
+  this->heap_index[axis] = -1;
+  this->heap_size--;
+  if (index == this->heap_size)
+    return;
+
+  // move the last entry into the hole and restore the heap order:
+  const Deadline moved = this->heap[this->heap_size];
+  place(index, moved);
+  siftUp(index);
+  siftDown(this->heap_index[moved.axis]);
+}
+
+void IRAM_ATTR StepScheduler::siftUp(int index)
+{
+  const Deadline entry = this->heap[index];
+  while (index > 0)
+  {
+    const int parent = (index - 1) / 2;
+    if (this->heap[parent].time <= entry.time)
+      break;
+    place(index, this->heap[parent]);
+    index = parent;
+  }
+  place(index, entry);
+}
+
+void IRAM_ATTR StepScheduler::siftDown(int index)
+{
+  const Deadline entry = this->heap[index];
+  for (;;)
+  {
+    int child = 2 * index + 1;
+    if (child >= this->heap_size)
+      break;
+    if (child + 1 < this->heap_size && this->heap[child + 1].time < this->heap[child].time)
+      child++;
+    if (entry.time <= this->heap[child].time)
+      break;
+    place(index, this->heap[child]);
+    index = child;
+  }
+  place(index, entry);
+}
+
+void IRAM_ATTR StepScheduler::place(int index, const Deadline &entry)
+{
+  this->heap[index] = entry;
+  this->heap_index[entry.axis] = index;
+}
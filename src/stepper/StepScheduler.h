@@ -0,0 +1,73 @@
+/*
+ * StepScheduler.h - Concurrent stepping of several Stepper instances
+ *
+ * Interleaves the steps of up to STEP_SCHEDULER_MAX_AXES motors on one
+ * esp_timer. Every running axis has an absolute deadline for its next step;
+ * the deadlines live in a binary min-heap so the timer is always armed for
+ * the earliest one. Each axis keeps its own speed and acceleration ramp.
+ *
+ * Steppers registered here must only be moved through the scheduler, not
+ * through Stepper::moveAsync().
+ */
+
+#ifndef StepScheduler_h
+#define StepScheduler_h
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "Stepper.h"
+
+#ifndef STEP_SCHEDULER_MAX_AXES
+#define STEP_SCHEDULER_MAX_AXES 8
+#endif
+
+class StepScheduler {
+  public:
+    StepScheduler();
+
+    // registers a motor, returns its axis index or -1 when all axes are taken:
+    int addAxis(Stepper *stepper);
+
+    // starts a move on one axis; a move still running there is stopped on
+    // the timer first and runs its completion callback:
+    bool move(int axis, int number_of_steps);
+
+    // ends the move of one axis after its current step:
+    void stop(int axis);
+
+    bool isRunning(int axis) const;
+    bool isIdle(void) const;
+
+  private:
+    struct Deadline {
+      int64_t time;   // esp_timer time of the next step, in us
+      uint8_t axis;
+    };
+
+    void push(uint8_t axis, int64_t time);
+    void remove(uint8_t axis);
+    void siftUp(int index);
+    void siftDown(int index);
+    void place(int index, const Deadline &entry);
+    void arm(void);
+    void service(void);
+    static void onTimer(void *arg);
+
+    Stepper *axes[STEP_SCHEDULER_MAX_AXES];
+    int axis_count;
+
+    Deadline heap[STEP_SCHEDULER_MAX_AXES];
+    int heap_size;
+    int heap_index[STEP_SCHEDULER_MAX_AXES]; // heap slot of each axis or -1
+
+    // axes advanced by service() outside the lock, and moves waiting for
+    // the axis to be free:
+    bool stepping[STEP_SCHEDULER_MAX_AXES];
+    bool deferred[STEP_SCHEDULER_MAX_AXES];
+    int deferred_steps[STEP_SCHEDULER_MAX_AXES];
+
+    esp_timer_handle_t timer;
+    portMUX_TYPE lock;
+};
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * StepTrace.cpp - Step timing recorder for the Stepper library
+ *
+ * See StepTrace.h for an overview.
+ */
+
+#include "StepTrace.h"
+
+StepTrace::StepTrace()
+{
+  clear();
+}
+
+void StepTrace::clear(void)
+{
+  this->head = 0;
+  this->recorded = 0;
+}
+
+int StepTrace::size(void) const
+{
+  return this->recorded < STEPPER_TRACE_SIZE ? (int)this->recorded : STEPPER_TRACE_SIZE;
+}
+
+const StepTrace::Sample &StepTrace::at(int i) const
+{
+  // once the buffer has wrapped, the oldest sample sits at head:
+  const int first = this->recorded < STEPPER_TRACE_SIZE ? 0 : this->head;
+  return this->samples[(first + i) % STEPPER_TRACE_SIZE];
+}
@@ -0,0 +1,64 @@
+/*
+ * StepTrace.h - Step timing recorder for the Stepper library
+ *
+ * Keeps the time of every step together with the interval the ramp asked
+ * for, so jitter (actual minus commanded interval) and the achieved step
+ * rate can be evaluated after a move. The buffer is a fixed array inside
+ * the object; the oldest samples are overwritten once it is full.
+ *
+ * Recording is opt-in: attach a trace with Stepper::setTrace() and detach
+ * it again with setTrace(NULL). A Stepper without a trace pays a single
+ * pointer test per step.
+ *
+ * record() is called from the step timer callback and must not overlap
+ * with readers; read the samples once the move has finished.
+ */
+
+#ifndef StepTrace_h
+#define StepTrace_h
+
+#include <stdint.h>
+#include "esp_attr.h"
+
+// number of samples kept, each takes 8 bytes:
+#ifndef STEPPER_TRACE_SIZE
+#define STEPPER_TRACE_SIZE 1024
+#endif
+
+class StepTrace {
+  public:
+    struct Sample {
+      uint32_t time;       // micros() when the step was taken
+      uint32_t commanded;  // ramp interval before this step in us, 0 on
+                           // the first step of a move
+    };
+
+    StepTrace();
+
+    // drops all samples:
+    void clear(void);
+
+    // adds one step, called by Stepper:
+    inline void IRAM_ATTR record(uint32_t time, uint32_t commanded)
+    {
+      this->samples[this->head] = { time, commanded };
+      this->head = (this->head + 1) % STEPPER_TRACE_SIZE;
+      this->recorded++;
+    }
+
+    // number of samples available, at most STEPPER_TRACE_SIZE:
+    int size(void) const;
+
+    // steps recorded since clear(), including overwritten ones:
+    uint32_t total(void) const { return this->recorded; }
+
+    // sample i, 0 being the oldest one still available:
+    const Sample &at(int i) const;
+
+  private:
+    Sample samples[STEPPER_TRACE_SIZE];
+    int head;               // slot of the next sample
+    volatile uint32_t recorded;
+};
+
+#endif
@@ -64,6 +64,28 @@
  *    3  0  1  0  1
  *    4  1  0  0  1
  *
+ * Half stepping on 4 control wires (setDriveMode(HALF_STEP)) interleaves
+ * the full steps with single-coil steps:
+ *
+ * Step C0 C1 C2 C3
+ *    1  1  0  1  0
+ *    2  0  0  1  0
+ *    3  0  1  1  0
+ *    4  0  1  0  0
+ *    5  0  1  0  1
+ *    6  0  0  0  1
+ *    7  1  0  0  1
+ *    8  1  0  0  0
+ *
+ * Wave drive on 4 control wires (setDriveMode(WAVE_DRIVE)) energises one
+ * coil at a time:
+ *
+ * Step C0 C1 C2 C3
+ *    1  0  0  1  0
+ *    2  0  1  0  0
+ *    3  0  0  0  1
+ *    4  1  0  0  0
+ *
  * The sequence of controls signals for 2 control wires is as follows
  * (columns C1 and C2 from above):
  *
@@ -79,7 +101,19 @@
  */
 
 #include "Arduino.h"
+#include "soc/gpio_struct.h"
 #include "Stepper.h"
+#include "StepPhases.h"
+
+/*
+ * Steps of asynchronous moves are emitted from the StepMove timer, from the
+ * timer interrupt when the sdkconfig allows ISR dispatch. Everything on that
+ * path (onStepTimer, advance, internalStep, stepMotor, the StepMove timer
+ * functions, the ramp lookup and the step trace) is placed in IRAM, so it
+ * also runs while the flash cache is disabled; completion callbacks must be
+ * IRAM_ATTR as well. requestStop() and currentPosition() are in IRAM too,
+ * for sensor interrupts that end a move.
+ */
 
 /*
  * two-wire constructor.
@@ -89,8 +123,9 @@ Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2)
 {
   this->step_number = 0;    // which step the motor is on
   this->direction = 0;      // motor direction
-  this->last_step_time = 0; // time stamp in us of the last step taken
+  this->position = 0;       // absolute position in steps
   this->number_of_steps = number_of_steps; // total number of steps for this motor
+  this->trace = NULL;
 
   // Arduino pins for the motor control connection:
   this->motor_pin_1 = motor_pin_1;
@@ -107,6 +142,7 @@ Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2)
 
   // pin_count is used by the stepMotor() method:
   this->pin_count = 2;
+  setDriveMode(FULL_STEP);
 }
 
 
@@ -119,8 +155,9 @@ Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2,
 {
   this->step_number = 0;    // which step the motor is on
   this->direction = 0;      // motor direction
-  this->last_step_time = 0; // time stamp in us of the last step taken
+  this->position = 0;       // absolute position in steps
   this->number_of_steps = number_of_steps; // total number of steps for this motor
+  this->trace = NULL;
 
   // Arduino pins for the motor control connection:
   this->motor_pin_1 = motor_pin_1;
@@ -139,6 +176,7 @@ Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2,
 
   // pin_count is used by the stepMotor() method:
   this->pin_count = 4;
+  setDriveMode(FULL_STEP);
 }
 
 /*
@@ -151,8 +189,9 @@ Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2,
 {
   this->step_number = 0;    // which step the motor is on
   this->direction = 0;      // motor direction
-  this->last_step_time = 0; // time stamp in us of the last step taken
+  this->position = 0;       // absolute position in steps
   this->number_of_steps = number_of_steps; // total number of steps for this motor
+  this->trace = NULL;
 
   // Arduino pins for the motor control connection:
   this->motor_pin_1 = motor_pin_1;
@@ -170,6 +209,7 @@ Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2,
 
   // pin_count is used by the stepMotor() method:
   this->pin_count = 5;
+  setDriveMode(FULL_STEP);
 }
 
 /*
@@ -177,7 +217,24 @@ Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2,
  */
 void Stepper::setSpeed(long whatSpeed)
 {
-  this->step_delay = 60L * 1000L * 1000L / this->number_of_steps / whatSpeed;
+  this->motion.setSpeed(this->number_of_steps, whatSpeed);
+}
+
+/*
+ * Sets the acceleration in steps per second squared. Has no effect with
+ * the CONSTANT profile.
+ */
+void Stepper::setAcceleration(long steps_per_s2)
+{
+  this->motion.setAcceleration(steps_per_s2);
+}
+
+/*
+ * Selects the acceleration profile: CONSTANT, TRAPEZOID or S_CURVE.
+ */
+void Stepper::setProfile(StepRamp::Profile profile)
+{
+  this->motion.setProfile(profile);
 }
 
 /*
@@ -187,46 +244,121 @@ void Stepper::setSpeed(long whatSpeed)
  */
 void Stepper::step(int steps_to_move)
 {
-  int steps_left = abs(steps_to_move);  // how many steps to take
+  const int steps_total = abs(steps_to_move);
 
   // determine direction based on whether steps_to_mode is + or -:
   if (steps_to_move > 0) { this->direction = 1; }
   if (steps_to_move < 0) { this->direction = 0; }
 
-  while (steps_left > 0)
+  for (int steps_done = 0; steps_done < steps_total; steps_done++)
   {
-    const uint32_t now = micros();
-    const uint32_t elapsed = (uint32_t)(now - this->last_step_time);
+    unsigned long now;
+    const unsigned long interval = this->motion.waitForStep(steps_done, steps_total, now);
+    internalStep(now, interval);
+  }
+}
 
-    // move only if the appropriate delay has passed:
-    if (elapsed >= this->step_delay)
-    {
-      internalStep(now, steps_left);
-      continue;
-    }
+/*
+ * Starts moving the motor steps_to_move steps and returns immediately.
+ * Steps are emitted from an esp_timer callback at the current speed; the
+ * completion callback (if any) is invoked from timer context once the move
+ * has finished or was stopped. A move in progress is replaced; its
+ * completion callback runs first.
+ */
+void Stepper::moveAsync(int steps_to_move)
+{
+  // cancel whatever is still running before taking over the timer:
+  if (!this->motion.takeTimer(&Stepper::onStepTimer, this))
+    return;
 
-    // RTOS-friendly wait (step_delay is in µs; FreeRTOS delays in ticks/ms)
-    const uint32_t remaining_us = (uint32_t)(this->step_delay - elapsed);
-    const TickType_t ticks = pdMS_TO_TICKS((remaining_us + 999) / 1000); // round up
+  if (steps_to_move == 0)
+    return;
 
-    if (ticks > 0)
-    {
-      vTaskDelay(ticks);
-    }
-    else
-    {
-      taskYIELD(); // remaining < 1 tick -> at least yield CPU
-    }
-  }
+  this->motion.armTimer(startMove(steps_to_move));
+}
+
+/*
+ * Returns true while an asynchronous move is in progress.
+ */
+bool Stepper::isRunning(void) const
+{
+  return this->motion.isRunning();
+}
+
+/*
+ * Ends an asynchronous move after the current step. The completion
+ * callback is still invoked.
+ */
+void Stepper::stop(void)
+{
+  this->motion.stop();
+}
+
+/*
+ * Interrupt-safe stop: no further step is taken, the move ends on its next
+ * deadline and then runs the completion callback.
+ */
+void IRAM_ATTR Stepper::requestStop(void)
+{
+  this->motion.requestStop();
+}
+
+/*
+ * Registers a function called when an asynchronous move ends.
+ */
+void Stepper::setCompletionCallback(CompletionCallback callback, void *arg)
+{
+  this->motion.setCompletionCallback(callback, arg);
+}
+
+/*
+ * Prepares an asynchronous move of steps_to_move steps without arming any
+ * timer and returns the delay in us before its first step. Used by
+ * moveAsync() and by StepScheduler, which then call advance() on time.
+ */
+unsigned long Stepper::startMove(int steps_to_move)
+{
+  if (steps_to_move > 0) { this->direction = 1; }
+  if (steps_to_move < 0) { this->direction = 0; }
+
+  return this->motion.start(steps_to_move);
 }
 
-void Stepper::internalStep(unsigned long now, int &steps_left) {
-  // get the timeStamp of when you stepped:
-      this->last_step_time = now;
+/*
+ * Takes the next step of the move prepared by startMove(). Returns true and
+ * the delay until the following step in next_delay while the move goes on,
+ * or false once it has finished (the completion callback has then run).
+ */
+bool IRAM_ATTR Stepper::advance(unsigned long &next_delay)
+{
+  unsigned long now, interval;
+  if (this->motion.nextStep(now, interval))
+    internalStep(now, interval);
+
+  return this->motion.advance(next_delay);
+}
+
+/*
+ * Timer callback of asynchronous moves: takes one step and re-arms the
+ * timer for the next deadline.
+ */
+void IRAM_ATTR Stepper::onStepTimer(void *arg)
+{
+  Stepper *stepper = (Stepper *)arg;
+
+  unsigned long next_delay;
+  if (stepper->advance(next_delay))
+    stepper->motion.rearmTimer(next_delay);
+}
+
+void IRAM_ATTR Stepper::internalStep(unsigned long now, unsigned long interval) {
+      if (this->trace != NULL)
+        this->trace->record(now, interval);
       // increment or decrement the step number,
       // depending on direction:
       if (this->direction == 1)
       {
+        this->position++;
         this->step_number++;
         if (this->step_number == this->number_of_steps) {
           this->step_number = 0;
@@ -234,148 +366,141 @@ void Stepper::internalStep(unsigned long now, int &steps_left) {
       }
       else
       {
+        this->position--;
         if (this->step_number == 0) {
           this->step_number = this->number_of_steps;
         }
         this->step_number--;
       }
-      // decrement the steps left:
-      steps_left--;
-      // step the motor to step number 0, 1, ..., {3 or 10}
-      if (this->pin_count == 5)
-        stepMotor(this->step_number % 10);
-      else
-        stepMotor(this->step_number % 4);
+      // step the motor to phase 0, 1, ..., phase_count - 1
+      stepMotor(this->step_number % this->phase_count);
 }
 
 /*
- * Moves the motor forward or backwards.
+ * Selects the phase sequence. HALF_STEP and WAVE_DRIVE need four wires;
+ * HALF_STEP has twice as many phases per revolution, so number_of_steps
+ * must count half steps. Returns false if the mode is not supported.
  */
-void Stepper::stepMotor(int thisStep)
+bool Stepper::setDriveMode(DriveMode mode)
 {
-  if (this->pin_count == 2) {
-    switch (thisStep) {
-      case 0:  // 01
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-      break;
-      case 1:  // 11
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, HIGH);
-      break;
-      case 2:  // 10
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-      break;
-      case 3:  // 00
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, LOW);
-      break;
-    }
+  const uint8_t *phases;
+  int count;
+
+  if (this->pin_count == 2 && mode == FULL_STEP) {
+    phases = two_wire_phases;
+    count = 4;
+  } else if (this->pin_count == 4 && mode == FULL_STEP) {
+    phases = four_wire_phases;
+    count = 4;
+  } else if (this->pin_count == 4 && mode == HALF_STEP) {
+    phases = half_step_phases;
+    count = 8;
+  } else if (this->pin_count == 4 && mode == WAVE_DRIVE) {
+    phases = wave_drive_phases;
+    count = 4;
+  } else if (this->pin_count == 5 && mode == FULL_STEP) {
+    phases = five_wire_phases;
+    count = 10;
+  } else {
+    return false;
   }
-  if (this->pin_count == 4) {
-    switch (thisStep) {
-      case 0:  // 1010
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-      break;
-      case 1:  // 0110
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-      break;
-      case 2:  //0101
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-      break;
-      case 3:  //1001
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-      break;
+
+  const int pins[5] = { this->motor_pin_1, this->motor_pin_2, this->motor_pin_3,
+                        this->motor_pin_4, this->motor_pin_5 };
+
+  // translate each coil bitmask into GPIO set/clear words, once:
+  for (int phase_index = 0; phase_index < count; phase_index++)
+  {
+    uint32_t set_low = 0, clear_low = 0, set_high = 0, clear_high = 0;
+    for (int coil = 0; coil < this->pin_count; coil++)
+    {
+      const bool on = (phases[phase_index] >> coil) & 1;
+      if (pins[coil] < 32)
+        (on ? set_low : clear_low) |= 1UL << pins[coil];
+      else
+        (on ? set_high : clear_high) |= 1UL << (pins[coil] - 32);
     }
+    this->phase_set_low[phase_index] = set_low;
+    this->phase_clear_low[phase_index] = clear_low;
+    this->phase_set_high[phase_index] = set_high;
+    this->phase_clear_high[phase_index] = clear_high;
   }
 
-  if (this->pin_count == 5) {
-    switch (thisStep) {
-      case 0:  // 01101
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-        digitalWrite(motor_pin_5, HIGH);
-        break;
-      case 1:  // 01001
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, LOW);
-        digitalWrite(motor_pin_5, HIGH);
-        break;
-      case 2:  // 01011
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-        digitalWrite(motor_pin_5, HIGH);
-        break;
-      case 3:  // 01010
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-        digitalWrite(motor_pin_5, LOW);
-        break;
-      case 4:  // 11010
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-        digitalWrite(motor_pin_5, LOW);
-        break;
-      case 5:  // 10010
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-        digitalWrite(motor_pin_5, LOW);
-        break;
-      case 6:  // 10110
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, HIGH);
-        digitalWrite(motor_pin_5, LOW);
-        break;
-      case 7:  // 10100
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-        digitalWrite(motor_pin_5, LOW);
-        break;
-      case 8:  // 10101
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-        digitalWrite(motor_pin_5, HIGH);
-        break;
-      case 9:  // 00101
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-        digitalWrite(motor_pin_5, HIGH);
-        break;
-    }
+  this->phase_count = count;
+  this->uses_high_bank = false;
+  for (int coil = 0; coil < this->pin_count; coil++)
+  {
+    if (pins[coil] >= 32)
+      this->uses_high_bank = true;
   }
+  return true;
+}
+
+/*
+ * Moves the motor forward or backwards. All coils of a phase switch with
+ * one write to the GPIO set and clear registers.
+ */
+void IRAM_ATTR Stepper::stepMotor(int thisStep)
+{
+  GPIO.out_w1ts = this->phase_set_low[thisStep];
+  GPIO.out_w1tc = this->phase_clear_low[thisStep];
+  if (this->uses_high_bank)
+  {
+    GPIO.out1_w1ts.val = this->phase_set_high[thisStep];
+    GPIO.out1_w1tc.val = this->phase_clear_high[thisStep];
+  }
+}
+
+/*
+ * Switches all coils off. The phase is kept, energize() restores it.
+ */
+void IRAM_ATTR Stepper::release(void)
+{
+  GPIO.out_w1tc = this->phase_set_low[0] | this->phase_clear_low[0];
+  if (this->uses_high_bank)
+    GPIO.out1_w1tc.val = this->phase_set_high[0] | this->phase_clear_high[0];
+}
+
+/*
+ * Drives the coils with the current phase again, e.g. after release().
+ */
+void IRAM_ATTR Stepper::energize(void)
+{
+  stepMotor(this->step_number % this->phase_count);
+}
+
+/*
+ * Returns the absolute position in steps, counted up in the forward
+ * direction and not wrapped at number_of_steps.
+ */
+long IRAM_ATTR Stepper::currentPosition(void) const
+{
+  return this->position;
+}
+
+/*
+ * Redefines the absolute position, e.g. after homing.
+ */
+void Stepper::setCurrentPosition(long position)
+{
+  this->position = position;
+}
+
+/*
+ * Returns the number of steps per revolution given to the constructor.
+ */
+int Stepper::stepsPerRevolution(void) const
+{
+  return this->number_of_steps;
+}
+
+/*
+ * Attaches a recorder that timestamps every step, or detaches it with NULL.
+ * Change it only while no move is running.
+ */
+void Stepper::setTrace(StepTrace *trace)
+{
+  this->trace = trace;
 }
 
 /*
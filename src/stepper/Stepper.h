@@ -61,6 +61,28 @@
  *    3  0  1  0  1
  *    4  1  0  0  1
  *
+ * Half stepping on 4 control wires (setDriveMode(HALF_STEP)) interleaves
+ * the full steps with single-coil steps:
+ *
+ * Step C0 C1 C2 C3
+ *    1  1  0  1  0
+ *    2  0  0  1  0
+ *    3  0  1  1  0
+ *    4  0  1  0  0
+ *    5  0  1  0  1
+ *    6  0  0  0  1
+ *    7  1  0  0  1
+ *    8  1  0  0  0
+ *
+ * Wave drive on 4 control wires (setDriveMode(WAVE_DRIVE)) energises one
+ * coil at a time:
+ *
+ * Step C0 C1 C2 C3
+ *    1  0  0  1  0
+ *    2  0  1  0  0
+ *    3  0  0  0  1
+ *    4  1  0  0  0
+ *
  * The sequence of controls signals for 2 control wires is as follows
  * (columns C1 and C2 from above):
  *
@@ -79,9 +101,23 @@
 #ifndef Stepper_h
 #define Stepper_h
 
+#include "StepMove.h"
+#include "StepRamp.h"
+#include "StepTrace.h"
+
 // library interface description
 class Stepper {
   public:
+    // phase sequences, see the tables above:
+    enum DriveMode {
+      FULL_STEP,
+      HALF_STEP,
+      WAVE_DRIVE
+    };
+
+    // completion callback for asynchronous moves, see StepMove:
+    typedef StepMove::CompletionCallback CompletionCallback;
+
     // constructors:
     Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2);
     Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2,
@@ -93,20 +129,51 @@ class Stepper {
     // speed setter method:
     void setSpeed(long whatSpeed);
 
+    // phase sequence setter, HALF_STEP and WAVE_DRIVE need four wires:
+    bool setDriveMode(DriveMode mode);
+
+    // acceleration setters, applied to every following move:
+    void setAcceleration(long steps_per_s2);
+    void setProfile(StepRamp::Profile profile);
+
     // mover method:
     void step(int number_of_steps);
 
+    // asynchronous mover methods, steps are emitted from an esp_timer:
+    void moveAsync(int number_of_steps);
+    bool isRunning(void) const;
+    void stop(void);
+    void requestStop(void);
+    void setCompletionCallback(CompletionCallback callback, void *arg);
+
+    // externally timed moves (see StepScheduler), moveAsync() uses these too:
+    unsigned long startMove(int number_of_steps);
+    bool advance(unsigned long &next_delay);
+
+    // coil power, the current phase is kept while released:
+    void release(void);
+    void energize(void);
+
+    // absolute position tracking:
+    long currentPosition(void) const;
+    void setCurrentPosition(long position);
+    int stepsPerRevolution(void) const;
+
+    // step timing recorder, NULL (the default) disables recording:
+    void setTrace(StepTrace *trace);
+
     int version(void);
 
   private:
     void stepMotor(int this_step);
-    void internalStep(unsigned long now, int &steps_left);
+    void internalStep(unsigned long now, unsigned long interval);
+    static void onStepTimer(void *arg);
 
     int direction;            // Direction of rotation
-    unsigned long step_delay; // delay between steps, in ms, based on speed
     int number_of_steps;      // total number of steps this motor can take
     int pin_count;            // how many pins are in use.
     int step_number;          // which step the motor is on
+    volatile long position;   // absolute position in steps
 
     // motor pin numbers:
     int motor_pin_1;
@@ -115,7 +182,18 @@ class Stepper {
     int motor_pin_4;
     int motor_pin_5;          // Only 5 phase motor
 
-    unsigned long last_step_time; // time stamp in us of when the last step was taken
+    // GPIO set/clear register words of each phase, for pins 0-31 and 32-39:
+    int phase_count;          // phases in the active sequence
+    bool uses_high_bank;      // true if any pin is 32 or above
+    uint32_t phase_set_low[10];
+    uint32_t phase_clear_low[10];
+    uint32_t phase_set_high[10];
+    uint32_t phase_clear_high[10];
+
+    // speed, ramp and asynchronous move state:
+    StepMove motion;
+
+    StepTrace *trace;                  // optional step timing recorder
 };
 
 #endif
@@ -0,0 +1,82 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the Arduino core, used by the native test env
+ * 
+ * Provides just what the hardware-independent modules (bus frames and
+ * windows, slave registry, pulse decoder, motor position model, dispense
+ * planner) call. Time only advances through hostAdvanceMillis(), GPIO
+ * reads return HIGH and interrupts are never raised.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+using std::min;
+using std::max;
+
+inline uint64_t& hostTimeUs() {
+    static uint64_t now = 0;
+    return now;
+}
+
+inline void hostAdvanceMillis(unsigned long ms) { hostTimeUs() += (uint64_t)ms * 1000; }
+
+inline unsigned long millis() { return (unsigned long)(hostTimeUs() / 1000); }
+inline unsigned long micros() { return (unsigned long)hostTimeUs(); }
+inline void delay(uint32_t ms) { hostAdvanceMillis(ms); }
+inline void delayMicroseconds(uint32_t us) { hostTimeUs() += us; }
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
+#define digitalPinToInterrupt(pin) (pin)
+inline void attachInterruptArg(uint8_t, void (*)(void*), void*, int) {}
+inline void detachInterrupt(uint8_t) {}
+
+/**
+ * @brief Swallows log output; set HOST_VERBOSE to see it
+ */
+class HostSerial {
+public:
+    template <typename... Args>
+    int printf(const char* format, Args... args) {
+#ifdef HOST_VERBOSE
+        return ::printf(format, args...);
+#else
+        (void)format;
+        return 0;
+#endif
+    }
+
+    template <typename T>
+    void print(const T&) {}
+
+    template <typename T>
+    void println(const T&) {}
+};
+
+static HostSerial Serial __attribute__((unused));
+
+#endif // HOST_ARDUINO_H
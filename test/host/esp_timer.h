@@ -0,0 +1,42 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+/**
+ * @file esp_timer.h
+ * @brief Host stand-in: timers are created but never fire
+ */
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef struct esp_timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+uint64_t& hostTimeUs();
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t*, esp_timer_handle_t* handle) {
+    static int dummy;
+    *handle = (esp_timer_handle_t)&dummy;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t, uint64_t) { return ESP_OK; }
+inline esp_err_t esp_timer_stop(esp_timer_handle_t) { return ESP_OK; }
+inline int64_t esp_timer_get_time() { return (int64_t)hostTimeUs(); }
+
+#endif // HOST_ESP_TIMER_H
@@ -0,0 +1,35 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+/**
+ * @file FreeRTOS.h
+ * @brief Host stand-in: single-threaded, tasks are never started
+ */
+
+#include <stdint.h>
+#include <limits.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+typedef struct {
+    int owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_SAFE(mux) ((void)(mux))
+#define portEXIT_CRITICAL_SAFE(mux) ((void)(mux))
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+
+inline BaseType_t xPortInIsrContext() { return pdFALSE; }
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,33 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite
+} eNotifyAction;
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void* param,
+                                          UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+    *handle = param;
+    return pdPASS;
+}
+
+inline void vTaskDelay(TickType_t) {}
+#define taskYIELD() ((void)0)
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t) { return pdPASS; }
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+inline BaseType_t xTaskNotify(TaskHandle_t, uint32_t, eNotifyAction) { return pdPASS; }
+inline BaseType_t xTaskNotifyFromISR(TaskHandle_t, uint32_t, eNotifyAction, BaseType_t*) { return pdPASS; }
+// Bits are unsigned long so ULONG_MAX, 32 bits on the target, fits on a 64-bit host
+inline BaseType_t xTaskNotifyWait(unsigned long, unsigned long, uint32_t*, TickType_t) { return pdFALSE; }
+
+#endif // HOST_FREERTOS_TASK_H
@@ -0,0 +1,157 @@
+/**
+ * @file test_main.cpp
+ * @brief Bus frame CRC, COBS round trip, resynchronisation and address filter
+ */
+
+#include <unity.h>
+#include "network/bus_frame.hpp"
+
+static FrameDecoder decoder;
+static uint8_t wire[BUS_MAX_ENCODED];
+
+static uint32_t rngState = 4711;
+
+static uint8_t nextByte() {
+    rngState = rngState * 1103515245u + 12345u;
+    return (uint8_t)(rngState >> 16);
+}
+
+static size_t encode(uint8_t type, uint8_t dst, uint8_t seq, const uint8_t* payload, uint8_t length) {
+    const BusFrame frame = {type, dst, seq, length, payload};
+    return encodeBusFrame(frame, wire, sizeof(wire));
+}
+
+/**
+ * @brief Feed bytes, return the result of the last one
+ */
+static FrameDecoder::Result feed(const uint8_t* bytes, size_t count) {
+    FrameDecoder::Result result = FrameDecoder::NONE;
+    for (size_t i = 0; i < count; i++) {
+        result = decoder.push(bytes[i]);
+    }
+    return result;
+}
+
+void setUp() {
+    decoder = FrameDecoder();
+}
+
+void tearDown() {}
+
+void test_crc_check_value() {
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, busCrc16(check, sizeof(check)));
+}
+
+void test_round_trip_every_length() {
+    uint8_t payload[BUS_MAX_PAYLOAD];
+    for (int length = 0; length <= BUS_MAX_PAYLOAD; length++) {
+        for (int i = 0; i < length; i++) {
+            // Plenty of zeros to exercise the stuffing
+            payload[i] = (nextByte() & 3) == 0 ? 0 : nextByte();
+        }
+        const size_t size = encode(FRAME_DATA, 0x00, (uint8_t)length, payload, (uint8_t)length);
+        TEST_ASSERT_TRUE(size > 0 && size <= BUS_MAX_ENCODED);
+        for (size_t i = 0; i + 1 < size; i++) {
+            TEST_ASSERT_NOT_EQUAL(0, wire[i]);
+        }
+        TEST_ASSERT_EQUAL_HEX8(0x00, wire[size - 1]);
+
+        TEST_ASSERT_EQUAL(FrameDecoder::FRAME, feed(wire, size));
+        const BusFrame& frame = decoder.frame();
+        TEST_ASSERT_EQUAL_HEX8(FRAME_DATA, frame.type);
+        TEST_ASSERT_EQUAL_HEX8(0x00, frame.dst);
+        TEST_ASSERT_EQUAL_UINT8(length, frame.seq);
+        TEST_ASSERT_EQUAL_UINT8(length, frame.length);
+        if (length > 0) {
+            TEST_ASSERT_EQUAL_UINT8_ARRAY(payload, frame.payload, length);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, decoder.getErrorCount());
+}
+
+void test_oversized_payload_is_not_encoded() {
+    uint8_t payload[BUS_MAX_PAYLOAD + 1] = {};
+    TEST_ASSERT_EQUAL(0, encode(FRAME_DATA, 1, 0, payload, BUS_MAX_PAYLOAD + 1));
+}
+
+void test_corrupt_byte_fails_crc() {
+    const uint8_t payload[] = {1, 2, 3, 0, 5};
+    const size_t size = encode(FRAME_DATA, 3, 9, payload, sizeof(payload));
+    for (size_t i = 1; i + 1 < size; i++) {
+        const uint8_t original = wire[i];
+        wire[i] = original == 0x01 ? 0x02 : original ^ 0x01;
+        TEST_ASSERT_EQUAL(FrameDecoder::ERROR, feed(wire, size));
+        wire[i] = original;
+    }
+    TEST_ASSERT_EQUAL(FrameDecoder::FRAME, feed(wire, size));
+}
+
+void test_resync_after_garbage_and_truncation() {
+    const uint8_t payload[] = {0xAA, 0x00, 0x55};
+    const size_t size = encode(FRAME_DATA, 7, 1, payload, sizeof(payload));
+
+    // A frame cut off by a delimiter, then line noise
+    feed(wire, size / 2);
+    TEST_ASSERT_EQUAL(FrameDecoder::ERROR, decoder.push(0x00));
+    const uint8_t noise[] = {0x13, 0x37, 0x42};
+    feed(noise, sizeof(noise));
+    TEST_ASSERT_EQUAL(FrameDecoder::ERROR, decoder.push(0x00));
+
+    TEST_ASSERT_EQUAL(FrameDecoder::FRAME, feed(wire, size));
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.getFrameCount());
+}
+
+void test_idle_delimiters_are_not_errors() {
+    const uint8_t idle[] = {0x00, 0x00, 0x00};
+    TEST_ASSERT_EQUAL(FrameDecoder::NONE, feed(idle, sizeof(idle)));
+    TEST_ASSERT_EQUAL_UINT32(0, decoder.getErrorCount());
+}
+
+void test_overlong_frame_is_dropped() {
+    for (int i = 0; i < BUS_MAX_RAW + 10; i++) {
+        decoder.push(0x01);
+    }
+    TEST_ASSERT_EQUAL(FrameDecoder::ERROR, decoder.push(0x00));
+}
+
+void test_address_filter() {
+    const uint8_t payload[] = {0x42};
+    decoder.setAddress(5, 0x02);
+
+    TEST_ASSERT_EQUAL(FrameDecoder::FRAME, feed(wire, encode(FRAME_DATA, 5, 0, payload, 1)));
+    TEST_ASSERT_EQUAL(FrameDecoder::FRAME, feed(wire, encode(FRAME_DATA, BUS_ADDR_BROADCAST, 0, payload, 1)));
+    TEST_ASSERT_EQUAL(FrameDecoder::NONE, feed(wire, encode(FRAME_DATA, 6, 0, payload, 1)));
+    TEST_ASSERT_EQUAL(FrameDecoder::FRAME,
+                      feed(wire, encode(FRAME_DATA | BUS_FRAME_MULTICAST, 0x03, 0, payload, 1)));
+    TEST_ASSERT_EQUAL(FrameDecoder::NONE,
+                      feed(wire, encode(FRAME_DATA | BUS_FRAME_MULTICAST, 0x04, 0, payload, 1)));
+    TEST_ASSERT_EQUAL_UINT32(2, decoder.getSkippedCount());
+    TEST_ASSERT_EQUAL_UINT32(0, decoder.getErrorCount());
+
+    decoder.acceptAll();
+    TEST_ASSERT_EQUAL(FrameDecoder::FRAME, feed(wire, encode(FRAME_DATA, 6, 0, payload, 1)));
+}
+
+void test_address_filter_with_zero_in_header() {
+    // dst 0x00 and seq 0x00 are stuffed, the filter must still see them
+    const uint8_t payload[] = {0x00};
+    decoder.setAddress(0x00, 0x01);
+    TEST_ASSERT_EQUAL(FrameDecoder::FRAME, feed(wire, encode(FRAME_DATA, 0x00, 0x00, payload, 1)));
+    decoder.setAddress(0x01, 0x01);
+    TEST_ASSERT_EQUAL(FrameDecoder::NONE, feed(wire, encode(FRAME_DATA, 0x00, 0x00, payload, 1)));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc_check_value);
+    RUN_TEST(test_round_trip_every_length);
+    RUN_TEST(test_oversized_payload_is_not_encoded);
+    RUN_TEST(test_corrupt_byte_fails_crc);
+    RUN_TEST(test_resync_after_garbage_and_truncation);
+    RUN_TEST(test_idle_delimiters_are_not_errors);
+    RUN_TEST(test_overlong_frame_is_dropped);
+    RUN_TEST(test_address_filter);
+    RUN_TEST(test_address_filter_with_zero_in_header);
+    return UNITY_END();
+}
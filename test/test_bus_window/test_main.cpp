@@ -0,0 +1,308 @@
+/**
+ * @file test_main.cpp
+ * @brief Sliding-window delivery: SACK, gap resend, duplicates, sequence wrap,
+ *        giving up and resynchronising, master reset
+ */
+
+#include <unity.h>
+#include <vector>
+#include "network/bus_window.hpp"
+
+/**
+ * @brief A frame as the master put it on the bus
+ */
+struct Sent {
+    uint8_t type;
+    uint8_t dst;
+    uint8_t seq;
+    std::vector<uint8_t> payload;
+};
+
+static SendWindow* master;
+static ReceiveWindow* slave;
+static std::vector<Sent> sent;
+static std::vector<int> delivered;
+static int droppedFrames;
+
+static void beginMaster(uint8_t epoch) {
+    delete master;
+    master = new SendWindow();
+    master->begin(
+        [](uint8_t type, uint8_t dst, uint8_t seq, const uint8_t* payload, uint8_t length) {
+            sent.push_back({type, dst, seq, std::vector<uint8_t>(payload, payload + length)});
+        },
+        [](uint8_t, uint8_t dropped) { droppedFrames += dropped; },
+        epoch);
+}
+
+static void sendValue(uint8_t value) {
+    TEST_ASSERT_TRUE(master->send(0, &value, 1));
+}
+
+/**
+ * @brief Hand one sent frame to the slave and its ACK back to the master
+ */
+static void deliver(const Sent& frame) {
+    const BusFrame busFrame = {frame.type, frame.dst, frame.seq, (uint8_t)frame.payload.size(),
+                               frame.payload.data()};
+    const bool acknowledge = slave->receive(busFrame, [](const uint8_t* payload, uint8_t) {
+        delivered.push_back(payload[0]);
+    });
+    if (acknowledge) {
+        master->acknowledge(0, slave->getNext(), slave->getSack());
+    }
+}
+
+/**
+ * @brief Deliver everything sent so far, except the frames in lose
+ */
+static void flush(const std::vector<size_t>& lose = std::vector<size_t>()) {
+    std::vector<Sent> frames;
+    frames.swap(sent);
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (std::find(lose.begin(), lose.end(), i) == lose.end()) {
+            deliver(frames[i]);
+        }
+    }
+}
+
+/**
+ * @brief Deliver and run the retransmission timers until all is acknowledged
+ */
+static void drain() {
+    for (int i = 0; i < 100 && master->pending() > 0; i++) {
+        flush();
+        if (master->pending() > 0) {
+            hostAdvanceMillis(BUS_RETRANSMIT_TIMEOUT);
+            master->poll(millis());
+        }
+    }
+}
+
+void setUp() {
+    beginMaster(0x40);
+    delete slave;
+    slave = new ReceiveWindow();
+    sent.clear();
+    delivered.clear();
+    droppedFrames = 0;
+}
+
+void tearDown() {}
+
+void test_sync_opens_the_stream() {
+    sendValue(1);
+    TEST_ASSERT_EQUAL(2, sent.size());
+    TEST_ASSERT_EQUAL_HEX8(FRAME_DATA_SYNC, sent[0].type);
+    TEST_ASSERT_EQUAL_HEX8(FRAME_DATA_SEQ, sent[1].type);
+    TEST_ASSERT_EQUAL_UINT8(sent[0].seq + 1, sent[1].seq);
+
+    flush();
+    TEST_ASSERT_EQUAL(1, delivered.size());
+    TEST_ASSERT_EQUAL(0, master->pending());
+}
+
+void test_master_reset_restarts_stream_behind_expected() {
+    for (int i = 0; i < 20; i++) {
+        sendValue((uint8_t)i);
+        flush();
+    }
+    TEST_ASSERT_EQUAL(20, delivered.size());
+    TEST_ASSERT_EQUAL_UINT8(21, slave->getNext());
+
+    // A rebooted master starts over at seq 0 with a new epoch; the slave
+    // keeps its window as no enumeration ran
+    beginMaster(0x91);
+    delivered.clear();
+    sendValue(100);
+    sendValue(101);
+    TEST_ASSERT_EQUAL_UINT8(0, sent[0].seq);
+    flush();
+
+    TEST_ASSERT_EQUAL(2, delivered.size());
+    TEST_ASSERT_EQUAL(100, delivered[0]);
+    TEST_ASSERT_EQUAL(101, delivered[1]);
+    TEST_ASSERT_EQUAL(0, master->pending());
+}
+
+void test_resent_sync_does_not_rewind() {
+    sendValue(1);
+    const Sent sync = sent[0];
+    flush();
+    sendValue(2);
+    flush();
+    TEST_ASSERT_EQUAL(2, delivered.size());
+
+    // A late copy of the opening SYNC arrives after the data
+    deliver(sync);
+    sendValue(3);
+    flush();
+    TEST_ASSERT_EQUAL(3, delivered.size());
+    TEST_ASSERT_EQUAL(3, delivered[2]);
+    TEST_ASSERT_EQUAL(0, master->pending());
+}
+
+void test_in_order_frames_release_the_window() {
+    for (int i = 0; i < BUS_SEND_WINDOW; i++) {
+        sendValue((uint8_t)i);
+    }
+    // SYNC takes one slot of the window, the last frame waits for it
+    TEST_ASSERT_EQUAL(BUS_SEND_WINDOW, sent.size());
+    TEST_ASSERT_EQUAL(BUS_SEND_WINDOW + 1, master->pending());
+
+    flush();
+    TEST_ASSERT_EQUAL(1, sent.size());
+    flush();
+    TEST_ASSERT_EQUAL(BUS_SEND_WINDOW, delivered.size());
+    for (int i = 0; i < BUS_SEND_WINDOW; i++) {
+        TEST_ASSERT_EQUAL(i, delivered[i]);
+    }
+    TEST_ASSERT_EQUAL(0, master->pending());
+}
+
+void test_sack_releases_frames_after_a_gap() {
+    sendValue(0);
+    flush();
+    for (int i = 1; i <= 4; i++) {
+        sendValue((uint8_t)i);
+    }
+    // Lose value 1; 2..4 are held and selectively acknowledged
+    const size_t lost = 0;
+    std::vector<Sent> frames = sent;
+    flush(std::vector<size_t>(1, lost));
+    TEST_ASSERT_EQUAL(1, delivered.size());
+    TEST_ASSERT_EQUAL_UINT32(0x7, slave->getSack());
+
+    // The gap is resent at once, not after the timeout, and only once
+    TEST_ASSERT_EQUAL(1, sent.size());
+    TEST_ASSERT_EQUAL_UINT8(frames[lost].seq, sent[0].seq);
+    TEST_ASSERT_EQUAL(1, master->pending());
+
+    flush();
+    TEST_ASSERT_EQUAL(5, delivered.size());
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL(i, delivered[i]);
+    }
+    TEST_ASSERT_EQUAL(0, master->pending());
+}
+
+void test_lost_ack_is_resent_after_timeout() {
+    sendValue(7);
+    flush();
+    sendValue(8);
+    const Sent frame = sent[0];
+    sent.clear();
+
+    // Frame lost: nothing happens before the timeout
+    hostAdvanceMillis(BUS_RETRANSMIT_TIMEOUT - 1);
+    master->poll(millis());
+    TEST_ASSERT_EQUAL(0, sent.size());
+    hostAdvanceMillis(1);
+    master->poll(millis());
+    TEST_ASSERT_EQUAL(1, sent.size());
+    TEST_ASSERT_EQUAL_UINT8(frame.seq, sent[0].seq);
+
+    flush();
+    TEST_ASSERT_EQUAL(2, delivered.size());
+    TEST_ASSERT_EQUAL(0, master->pending());
+}
+
+void test_duplicates_are_delivered_once() {
+    sendValue(1);
+    sendValue(2);
+    std::vector<Sent> frames = sent;
+    flush();
+    for (size_t i = 0; i < frames.size(); i++) {
+        deliver(frames[i]);
+    }
+    // Held ahead of a gap and then repeated
+    sendValue(3);
+    sendValue(4);
+    frames = sent;
+    sent.clear();
+    deliver(frames[1]);
+    deliver(frames[1]);
+    deliver(frames[0]);
+    deliver(frames[1]);
+
+    TEST_ASSERT_EQUAL(4, delivered.size());
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(i + 1, delivered[i]);
+    }
+    TEST_ASSERT_EQUAL(0, master->pending());
+}
+
+void test_sequence_numbers_wrap() {
+    // Lose one frame in every window so SACK and gaps cross the wrap
+    int value = 0;
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 4; i++) {
+            sendValue((uint8_t)value++);
+        }
+        flush(std::vector<size_t>(1, (size_t)(round % 4)));
+        drain();
+    }
+    TEST_ASSERT_EQUAL(400, delivered.size());
+    for (int i = 0; i < 400; i++) {
+        TEST_ASSERT_EQUAL((uint8_t)i, delivered[i]);
+    }
+    TEST_ASSERT_EQUAL(0, master->pending());
+}
+
+void test_give_up_drops_and_resyncs() {
+    sendValue(1);
+    flush();
+    sendValue(2);
+    sendValue(3);
+    const uint8_t firstEpoch = 0x41;
+    sent.clear();
+
+    // Slave gone: every retry is lost
+    for (int i = 0; i <= BUS_MAX_RETRIES; i++) {
+        hostAdvanceMillis(BUS_RETRANSMIT_TIMEOUT);
+        master->poll(millis());
+        sent.clear();
+    }
+    TEST_ASSERT_EQUAL(2, droppedFrames);
+    TEST_ASSERT_EQUAL(0, master->pending());
+
+    // A late ACK of the old stream must not disturb the new one
+    master->acknowledge(0, 2, 0);
+    sendValue(4);
+    TEST_ASSERT_EQUAL(2, sent.size());
+    TEST_ASSERT_EQUAL_HEX8(FRAME_DATA_SYNC, sent[0].type);
+    TEST_ASSERT_EQUAL(1, sent[0].payload.size());
+    TEST_ASSERT_EQUAL_HEX8(firstEpoch + 1, sent[0].payload[0]);
+
+    // The slave has seen frames of the old stream, the SYNC skips them
+    flush();
+    TEST_ASSERT_EQUAL(2, delivered.size());
+    TEST_ASSERT_EQUAL(4, delivered[1]);
+    TEST_ASSERT_EQUAL(0, master->pending());
+}
+
+void test_unsynced_slave_ignores_data() {
+    sendValue(1);
+    std::vector<Sent> frames = sent;
+    sent.clear();
+    deliver(frames[1]);
+    TEST_ASSERT_EQUAL(0, delivered.size());
+    deliver(frames[0]);
+    deliver(frames[1]);
+    TEST_ASSERT_EQUAL(1, delivered.size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_sync_opens_the_stream);
+    RUN_TEST(test_master_reset_restarts_stream_behind_expected);
+    RUN_TEST(test_resent_sync_does_not_rewind);
+    RUN_TEST(test_in_order_frames_release_the_window);
+    RUN_TEST(test_sack_releases_frames_after_a_gap);
+    RUN_TEST(test_lost_ack_is_resent_after_timeout);
+    RUN_TEST(test_duplicates_are_delivered_once);
+    RUN_TEST(test_sequence_numbers_wrap);
+    RUN_TEST(test_give_up_drops_and_resyncs);
+    RUN_TEST(test_unsynced_slave_ignores_data);
+    return UNITY_END();
+}
@@ -0,0 +1,177 @@
+/**
+ * @file test_main.cpp
+ * @brief DispensePlanner against an exhaustive search of every stop order
+ */
+
+#include <unity.h>
+#include <vector>
+#include "motor/dispense_planner.hpp"
+
+/**
+ * @brief Position-only motor, moves complete instantly
+ */
+class FakeMotor : public Motor {
+public:
+    void initialize() override {}
+    void setSpeed(double) override {}
+    void setAcceleration(long, StepRamp::Profile) override {}
+    void step(int steps) override { position += steps; }
+    bool moveAsync(int steps) override { position += steps; return steps != 0; }
+    bool isRunning() override { return false; }
+    void stop() override {}
+    void setCompletionCallback(CompletionCallback, void*) override {}
+    long getPosition() override { return position; }
+    void setPosition(long value) override { position = value; }
+    long getStepsPerRevolution() override { return 200; }
+
+    long position = 0;
+};
+
+static FakeMotor motor;
+static DispensePlanner planner(motor);
+
+static uint32_t rngState = 12345;
+
+static uint32_t nextRandom(uint32_t bound) {
+    rngState = rngState * 1103515245u + 12345u;
+    return (rngState >> 8) % bound;
+}
+
+/**
+ * @brief Seek travel of stops visited in the given order, same cost model
+ *        as the motor: shortest way round, then count pills forward
+ */
+static long travelOf(long start, const std::vector<DispenseStop>& stops) {
+    long position = start;
+    long total = 0;
+    for (const DispenseStop& stop : stops) {
+        const long move = motor.shortestMove(position, stop.compartment);
+        total += labs(move);
+        position += move + (long)stop.count * DISPENSE_STEPS_PER_PILL;
+    }
+    return total;
+}
+
+static long bruteForce(long start, std::vector<DispenseStop> stops) {
+    std::sort(stops.begin(), stops.end(), [](const DispenseStop& a, const DispenseStop& b) {
+        return a.compartment < b.compartment;
+    });
+    long best = LONG_MAX;
+    do {
+        best = std::min(best, travelOf(start, stops));
+    } while (std::next_permutation(stops.begin(), stops.end(), [](const DispenseStop& a, const DispenseStop& b) {
+        return a.compartment < b.compartment;
+    }));
+    return best;
+}
+
+/**
+ * @brief Random batch of distinct compartments
+ */
+static std::vector<DispenseRequest> randomBatch(size_t size) {
+    std::vector<DispenseRequest> batch;
+    uint8_t compartments[COMPARTMENT_COUNT];
+    for (uint8_t i = 0; i < COMPARTMENT_COUNT; i++) {
+        compartments[i] = i;
+    }
+    for (size_t i = 0; i < size; i++) {
+        const size_t pick = i + nextRandom(COMPARTMENT_COUNT - i);
+        std::swap(compartments[i], compartments[pick]);
+        batch.push_back({compartments[i], (uint16_t)(1 + nextRandom(6))});
+    }
+    return batch;
+}
+
+/**
+ * @brief Check the plan visits every requested compartment once with its count
+ *        and that the reported travel matches the emitted moves
+ */
+static void checkPlan(const std::vector<DispenseRequest>& batch, const DispenseStop* stops, size_t count) {
+    TEST_ASSERT_EQUAL(batch.size(), count);
+    long travel = 0;
+    for (const DispenseRequest& request : batch) {
+        size_t found = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (stops[i].compartment == request.compartment) {
+                TEST_ASSERT_EQUAL_UINT16(request.count, stops[i].count);
+                found++;
+            }
+        }
+        TEST_ASSERT_EQUAL(1, found);
+    }
+    for (size_t i = 0; i < count; i++) {
+        travel += labs(stops[i].travel);
+    }
+    TEST_ASSERT_EQUAL(travel, planner.getTotalTravel());
+}
+
+static std::vector<DispenseStop> asVector(const DispenseStop* stops, size_t count) {
+    return std::vector<DispenseStop>(stops, stops + count);
+}
+
+void test_exact_matches_brute_force() {
+    planner.setExactLimit(PLANNER_EXACT_LIMIT);
+    for (int round = 0; round < 200; round++) {
+        motor.position = nextRandom(2000);
+        const std::vector<DispenseRequest> batch = randomBatch(1 + nextRandom(COMPARTMENT_COUNT));
+        DispenseStop stops[COMPARTMENT_COUNT];
+        const size_t count = planner.plan(batch.data(), batch.size(), stops);
+
+        checkPlan(batch, stops, count);
+        TEST_ASSERT_EQUAL(bruteForce(motor.position, asVector(stops, count)), planner.getTotalTravel());
+    }
+}
+
+void test_heuristic_is_valid_and_never_beats_optimum() {
+    planner.setExactLimit(0);
+    for (int round = 0; round < 200; round++) {
+        motor.position = nextRandom(2000);
+        const std::vector<DispenseRequest> batch = randomBatch(1 + nextRandom(COMPARTMENT_COUNT));
+        DispenseStop stops[COMPARTMENT_COUNT];
+        const size_t count = planner.plan(batch.data(), batch.size(), stops);
+
+        checkPlan(batch, stops, count);
+        TEST_ASSERT_GREATER_OR_EQUAL(bruteForce(motor.position, asVector(stops, count)), planner.getTotalTravel());
+    }
+    planner.setExactLimit(PLANNER_EXACT_LIMIT);
+}
+
+void test_requests_are_merged_per_compartment() {
+    motor.position = 0;
+    const DispenseRequest batch[] = {{3, 1}, {5, 2}, {3, 4}, {COMPARTMENT_COUNT, 1}, {6, 0}};
+    DispenseStop stops[COMPARTMENT_COUNT];
+    const size_t count = planner.plan(batch, 5, stops);
+
+    TEST_ASSERT_EQUAL(2, count);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_UINT16(stops[i].compartment == 3 ? 5 : 2, stops[i].count);
+    }
+}
+
+void test_enqueue_is_all_or_nothing() {
+    MotionTask task;
+    TEST_ASSERT_TRUE(task.begin(&motor));
+    const MotionSegment filler = { 1, 0, StepRamp::TRAPEZOID, 0, MotionSegment::MOVE };
+    while (task.freeSlots() > 3) {
+        TEST_ASSERT_TRUE(task.enqueue(filler));
+    }
+
+    const DispenseStop stops[] = {{1, 1, 25}, {2, 1, 0}};
+    TEST_ASSERT_FALSE(planner.enqueue(task, stops, 2, 7));
+    TEST_ASSERT_EQUAL(3, task.freeSlots());
+
+    TEST_ASSERT_TRUE(planner.enqueue(task, stops, 1, 7));
+    TEST_ASSERT_EQUAL(1, task.freeSlots());
+}
+
+void setUp() {}
+void tearDown() {}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_exact_matches_brute_force);
+    RUN_TEST(test_heuristic_is_valid_and_never_beats_optimum);
+    RUN_TEST(test_requests_are_merged_per_compartment);
+    RUN_TEST(test_enqueue_is_all_or_nothing);
+    return UNITY_END();
+}
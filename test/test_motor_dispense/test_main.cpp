@@ -0,0 +1,155 @@
+/**
+ * @file test_main.cpp
+ * @brief Motor::dispense() end to end: sensor interrupt, counting, stop
+ *        without a further step, bounce, overrun bound, learned spacing
+ */
+
+#include <unity.h>
+#include <vector>
+#include "motor/motor.hpp"
+
+/**
+ * @brief Backend stepping one step at a time under test control, stopped
+ *        from the pill interrupt like the real ones
+ */
+class SimulatedMotor : public Motor {
+public:
+    SimulatedMotor() { setIsrAccess(&SimulatedMotor::positionFromISR, &SimulatedMotor::stopFromISR); }
+
+    void initialize() override {}
+    void setSpeed(double) override {}
+    void setAcceleration(long, StepRamp::Profile) override {}
+    void step(int steps) override { position += steps; }
+
+    bool moveAsync(int steps) override {
+        if (steps == 0) {
+            return false;
+        }
+        lastMove = steps;
+        remaining = steps > 0 ? steps : -steps;
+        direction = steps > 0 ? 1 : -1;
+        stopRequested = false;
+        return true;
+    }
+
+    bool isRunning() override { return remaining > 0; }
+    void stop() override { stopRequested = true; }
+    void setCompletionCallback(CompletionCallback, void*) override {}
+    long getPosition() override { return position; }
+    void setPosition(long value) override { position = value; }
+    long getStepsPerRevolution() override { return 200; }
+
+    /**
+     * @brief Take one step of the running move, as the step timer would
+     * @return false once the move has ended
+     */
+    bool tick() {
+        if (remaining == 0 || stopRequested) {
+            remaining = 0;
+            return false;
+        }
+        position += direction;
+        remaining--;
+        return true;
+    }
+
+    long position = 0;
+    int lastMove = 0;
+
+private:
+    static long positionFromISR(Motor* motor) { return static_cast<SimulatedMotor*>(motor)->position; }
+    static void stopFromISR(Motor* motor) { static_cast<SimulatedMotor*>(motor)->stopRequested = true; }
+
+    int remaining = 0;
+    int direction = 1;
+    bool stopRequested = false;
+};
+
+static SimulatedMotor* motor;
+static SimulatedPillSensor sensor;
+
+/**
+ * @brief Run the move to its end, dropping a pill past the sensor at each
+ *        of the given positions
+ */
+static void runDispense(const std::vector<long>& pills) {
+    while (motor->tick()) {
+        for (long pill : pills) {
+            if (pill == motor->position) {
+                sensor.trigger();
+            }
+        }
+    }
+}
+
+void setUp() {
+    delete motor;
+    motor = new SimulatedMotor();
+    motor->setPillSensor(&sensor);
+}
+
+void tearDown() {}
+
+void test_stops_on_the_last_pill() {
+    TEST_ASSERT_TRUE(motor->dispense(3));
+    TEST_ASSERT_EQUAL(3 * DISPENSE_STEPS_PER_PILL * DISPENSE_OVERRUN_FACTOR, motor->lastMove);
+
+    runDispense({20, 45, 70, 95});
+    TEST_ASSERT_EQUAL_UINT16(3, motor->getDispensedCount());
+
+    // Stopped from the interrupt: not a single step after the third pill
+    TEST_ASSERT_EQUAL(70, motor->position);
+    TEST_ASSERT_FALSE(motor->isRunning());
+}
+
+void test_bounce_does_not_stop_early() {
+    TEST_ASSERT_TRUE(motor->dispense(2));
+    runDispense({20, 20 + DISPENSE_MIN_PILL_SPACING - 1, 45});
+    TEST_ASSERT_EQUAL_UINT16(2, motor->getDispensedCount());
+    TEST_ASSERT_EQUAL(45, motor->position);
+}
+
+void test_overrun_bound_ends_an_empty_compartment() {
+    TEST_ASSERT_TRUE(motor->dispense(2));
+    runDispense({20});
+    TEST_ASSERT_EQUAL_UINT16(1, motor->getDispensedCount());
+    TEST_ASSERT_EQUAL(2 * DISPENSE_STEPS_PER_PILL * DISPENSE_OVERRUN_FACTOR, motor->position);
+}
+
+void test_next_dispense_uses_learned_spacing() {
+    TEST_ASSERT_TRUE(motor->dispense(3));
+    runDispense({10, 40, 70});
+    TEST_ASSERT_EQUAL(30, motor->getStepsPerPill());
+
+    TEST_ASSERT_TRUE(motor->dispense(2));
+    TEST_ASSERT_EQUAL(2 * 30 * DISPENSE_OVERRUN_FACTOR, motor->lastMove);
+    runDispense({100, 130});
+    TEST_ASSERT_EQUAL_UINT16(2, motor->getDispensedCount());
+    TEST_ASSERT_EQUAL(130, motor->position);
+}
+
+void test_edges_outside_a_dispense_are_ignored() {
+    sensor.trigger();
+    TEST_ASSERT_TRUE(motor->moveAsync(50));
+    runDispense({10, 30});
+    TEST_ASSERT_EQUAL(50, motor->position);
+    TEST_ASSERT_EQUAL_UINT16(0, motor->getDispensedCount());
+}
+
+void test_dispense_needs_a_sensor_and_a_count() {
+    TEST_ASSERT_FALSE(motor->dispense(0));
+    motor->setPillSensor(nullptr);
+    TEST_ASSERT_FALSE(motor->dispense(1));
+    TEST_ASSERT_FALSE(motor->isRunning());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_stops_on_the_last_pill);
+    RUN_TEST(test_bounce_does_not_stop_early);
+    RUN_TEST(test_overrun_bound_ends_an_empty_compartment);
+    RUN_TEST(test_next_dispense_uses_learned_spacing);
+    RUN_TEST(test_edges_outside_a_dispense_are_ignored);
+    RUN_TEST(test_dispense_needs_a_sensor_and_a_count);
+    return UNITY_END();
+}
@@ -0,0 +1,75 @@
+/**
+ * @file test_main.cpp
+ * @brief PillCounter target, bounce filter and spacing average
+ */
+
+#include <unity.h>
+#include "motor/pill_counter.hpp"
+
+static PillCounter counter;
+
+void test_stops_exactly_at_target() {
+    counter.arm(3, 0, 4);
+    TEST_ASSERT_FALSE(counter.onPillDetected(10));
+    TEST_ASSERT_FALSE(counter.onPillDetected(35));
+    TEST_ASSERT_TRUE(counter.onPillDetected(60));
+    TEST_ASSERT_TRUE(counter.isComplete());
+    TEST_ASSERT_FALSE(counter.isArmed());
+
+    // Late detections after the stop are ignored
+    TEST_ASSERT_FALSE(counter.onPillDetected(85));
+    TEST_ASSERT_EQUAL_UINT16(3, counter.getCount());
+}
+
+void test_bounces_are_filtered() {
+    counter.arm(2, 100, 4);
+    TEST_ASSERT_FALSE(counter.onPillDetected(102));     // Bounce of the pill before the start
+    TEST_ASSERT_EQUAL_UINT16(0, counter.getCount());
+    TEST_ASSERT_FALSE(counter.onPillDetected(120));
+    TEST_ASSERT_FALSE(counter.onPillDetected(121));     // Bounce of the first pill
+    TEST_ASSERT_EQUAL_UINT16(1, counter.getCount());
+    TEST_ASSERT_TRUE(counter.onPillDetected(145));
+}
+
+void test_first_pill_does_not_skew_average() {
+    PillCounter fresh;
+    fresh.arm(4, 0, 4);
+    fresh.onPillDetected(90);                           // Far from the start, not a spacing
+    TEST_ASSERT_EQUAL(0, fresh.getStepsPerPill());
+    fresh.onPillDetected(110);
+    fresh.onPillDetected(130);
+    fresh.onPillDetected(150);
+    TEST_ASSERT_EQUAL(20, fresh.getStepsPerPill());
+
+    // The average carries over into the next dispense
+    fresh.arm(2, 150, 4);
+    fresh.onPillDetected(400);
+    TEST_ASSERT_EQUAL(20, fresh.getStepsPerPill());
+}
+
+void test_short_dispense_is_incomplete() {
+    counter.arm(3, 0, 4);
+    counter.onPillDetected(25);
+    counter.disarm();
+    TEST_ASSERT_FALSE(counter.isComplete());
+    TEST_ASSERT_EQUAL_UINT16(1, counter.getCount());
+}
+
+void test_zero_target_stays_disarmed() {
+    counter.arm(0, 0, 4);
+    TEST_ASSERT_FALSE(counter.isArmed());
+    TEST_ASSERT_FALSE(counter.onPillDetected(25));
+}
+
+void setUp() {}
+void tearDown() {}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_stops_exactly_at_target);
+    RUN_TEST(test_bounces_are_filtered);
+    RUN_TEST(test_first_pill_does_not_skew_average);
+    RUN_TEST(test_short_dispense_is_incomplete);
+    RUN_TEST(test_zero_target_stays_disarmed);
+    return UNITY_END();
+}
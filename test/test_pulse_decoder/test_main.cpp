@@ -0,0 +1,87 @@
+/**
+ * @file test_main.cpp
+ * @brief PulseDecoder token rounding, glitch filter and cycle counter wrap
+ */
+
+#include <unity.h>
+#include "network/pulse_decoder.hpp"
+
+static const uint32_t cyclesPerUs = 240;
+
+static PulseDecoder decoder;
+
+/**
+ * @brief Feed one LOW pulse of widthUs starting at cycle start
+ * @return Result of the rising edge
+ */
+static bool pulse(uint32_t start, uint32_t widthUs) {
+    TEST_ASSERT_FALSE(decoder.push({start, LOW}));
+    return decoder.push({start + widthUs * cyclesPerUs, HIGH});
+}
+
+void setUp() {
+    decoder.begin(cyclesPerUs);
+}
+
+void tearDown() {}
+
+void test_chain_pulse_is_token_zero() {
+    TEST_ASSERT_TRUE(pulse(1000, BUS_CHAIN_PULSE_US));
+    TEST_ASSERT_EQUAL_UINT8(0, decoder.token());
+    TEST_ASSERT_EQUAL_UINT32(BUS_CHAIN_PULSE_US, decoder.width());
+}
+
+void test_tokens_round_to_the_nearest_unit() {
+    // Token n is (n + 1) units; half a unit either side still counts
+    const uint32_t unit = SERIAL_TOKEN_UNIT_US;
+    for (uint32_t n = 0; n < 10; n++) {
+        const uint32_t nominal = (n + 1) * unit;
+        TEST_ASSERT_TRUE(pulse(0, nominal));
+        TEST_ASSERT_EQUAL_UINT8(n, decoder.token());
+        TEST_ASSERT_TRUE(pulse(0, nominal + unit / 2 - 1));
+        TEST_ASSERT_EQUAL_UINT8(n, decoder.token());
+        TEST_ASSERT_TRUE(pulse(0, nominal + unit / 2));
+        TEST_ASSERT_EQUAL_UINT8(n + 1, decoder.token());
+    }
+
+    // Below half a unit but above the glitch limit is still token 0
+    TEST_ASSERT_TRUE(pulse(0, SERIAL_TOKEN_MIN_US));
+    TEST_ASSERT_EQUAL_UINT8(0, decoder.token());
+
+    // Overlong pulses saturate
+    TEST_ASSERT_TRUE(pulse(0, 1000 * unit));
+    TEST_ASSERT_EQUAL_UINT8(255, decoder.token());
+}
+
+void test_glitches_are_ignored() {
+    TEST_ASSERT_FALSE(pulse(0, SERIAL_TOKEN_MIN_US - 1));
+    TEST_ASSERT_FALSE(decoder.push({100, HIGH}));
+}
+
+void test_counter_wrap() {
+    const uint32_t start = 0xFFFFFFFFu - 5 * cyclesPerUs;
+    TEST_ASSERT_TRUE(pulse(start, 3 * SERIAL_TOKEN_UNIT_US));
+    TEST_ASSERT_EQUAL_UINT8(2, decoder.token());
+    TEST_ASSERT_EQUAL_UINT32(3 * SERIAL_TOKEN_UNIT_US, decoder.width());
+}
+
+void test_reset_drops_the_pulse_in_progress() {
+    TEST_ASSERT_FALSE(decoder.push({0, LOW}));
+    decoder.reset();
+    TEST_ASSERT_FALSE(decoder.push({BUS_CHAIN_PULSE_US * cyclesPerUs, HIGH}));
+
+    // A repeated falling edge restarts the measurement
+    TEST_ASSERT_FALSE(decoder.push({0, LOW}));
+    TEST_ASSERT_TRUE(pulse(100 * cyclesPerUs, BUS_CHAIN_PULSE_US));
+    TEST_ASSERT_EQUAL_UINT32(BUS_CHAIN_PULSE_US, decoder.width());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_chain_pulse_is_token_zero);
+    RUN_TEST(test_tokens_round_to_the_nearest_unit);
+    RUN_TEST(test_glitches_are_ignored);
+    RUN_TEST(test_counter_wrap);
+    RUN_TEST(test_reset_drops_the_pulse_in_progress);
+    return UNITY_END();
+}
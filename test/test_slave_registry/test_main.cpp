@@ -0,0 +1,160 @@
+/**
+ * @file test_main.cpp
+ * @brief SlaveRegistry probing collisions, truncation, capacity and fingerprint
+ */
+
+#include <unity.h>
+#include "network/slave_registry.hpp"
+
+static SlaveRegistry registry;
+
+static const uint16_t indexSize = slaveIndexSize(1);
+
+static void makeMac(uint32_t n, uint8_t* mac) {
+    // Shared vendor prefix, like boxes from one batch
+    mac[0] = 0x24;
+    mac[1] = 0x0A;
+    mac[2] = 0xC4;
+    mac[3] = (n >> 16) & 0xFF;
+    mac[4] = (n >> 8) & 0xFF;
+    mac[5] = n & 0xFF;
+}
+
+/**
+ * @brief Index slot a MAC hashes to, as the registry computes it
+ */
+static uint16_t slotOf(const uint8_t* mac) {
+    const uint32_t h = SlaveRegistry::chainHash(SlaveRegistry::CHAIN_SEED, mac);
+    return (uint16_t)((h ^ (h >> 16)) & (indexSize - 1));
+}
+
+/**
+ * @brief Find count MACs that all hash to slot
+ */
+static void collidingMacs(uint16_t slot, uint8_t (*macs)[6], int count) {
+    int found = 0;
+    for (uint32_t n = 0; found < count; n++) {
+        makeMac(n, macs[found]);
+        if (slotOf(macs[found]) == slot) {
+            found++;
+        }
+    }
+}
+
+void setUp() {
+    registry.clear();
+}
+
+void tearDown() {}
+
+void test_add_assigns_addresses_in_order() {
+    uint8_t mac[6];
+    for (int i = 0; i < 5; i++) {
+        makeMac(1000 + i, mac);
+        TEST_ASSERT_EQUAL(i, registry.add(mac));
+    }
+    TEST_ASSERT_EQUAL(5, registry.size());
+
+    // A known MAC keeps its address
+    makeMac(1002, mac);
+    TEST_ASSERT_EQUAL(2, registry.add(mac));
+    TEST_ASSERT_EQUAL(5, registry.size());
+    TEST_ASSERT_EQUAL(2, registry.find(mac));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(mac, registry.get(2)->mac, 6);
+    TEST_ASSERT_NULL(registry.get(5));
+}
+
+void test_colliding_macs_probe_past_each_other() {
+    // The last slot also makes the probe sequence wrap around
+    uint8_t macs[5][6];
+    collidingMacs(indexSize - 1, macs, 5);
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(i, registry.add(macs[i]));
+    }
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(i, registry.find(macs[i]));
+    }
+
+    // An unknown MAC on the same slot probes up to the empty slot behind them
+    TEST_ASSERT_EQUAL(-1, registry.find(macs[4]));
+    TEST_ASSERT_EQUAL(4, registry.add(macs[4]));
+    TEST_ASSERT_EQUAL(4, registry.find(macs[4]));
+}
+
+void test_truncate_rebuilds_the_index() {
+    uint8_t macs[6][6];
+    collidingMacs(3, macs, 6);
+    for (int i = 0; i < 6; i++) {
+        registry.add(macs[i]);
+    }
+
+    registry.truncate(2);
+    TEST_ASSERT_EQUAL(2, registry.size());
+    TEST_ASSERT_EQUAL(0, registry.find(macs[0]));
+    TEST_ASSERT_EQUAL(1, registry.find(macs[1]));
+    for (int i = 2; i < 6; i++) {
+        TEST_ASSERT_EQUAL(-1, registry.find(macs[i]));
+    }
+    TEST_ASSERT_NULL(registry.get(2));
+
+    // Slaves behind the cut come back under new addresses
+    TEST_ASSERT_EQUAL(2, registry.add(macs[5]));
+    TEST_ASSERT_EQUAL(3, registry.add(macs[2]));
+    TEST_ASSERT_EQUAL(2, registry.find(macs[5]));
+    TEST_ASSERT_EQUAL(3, registry.find(macs[2]));
+
+    // Truncating to the current size or beyond keeps everything
+    registry.truncate(10);
+    TEST_ASSERT_EQUAL(4, registry.size());
+}
+
+void test_add_rejects_when_full() {
+    uint8_t mac[6];
+    for (int i = 0; i < MAX_SLAVES; i++) {
+        makeMac(i, mac);
+        TEST_ASSERT_EQUAL(i, registry.add(mac));
+    }
+    TEST_ASSERT_EQUAL(registry.capacity(), registry.size());
+
+    makeMac(MAX_SLAVES, mac);
+    TEST_ASSERT_EQUAL(-1, registry.add(mac));
+    TEST_ASSERT_EQUAL(-1, registry.find(mac));
+    TEST_ASSERT_EQUAL(MAX_SLAVES, registry.size());
+
+    // Known slaves are still found and re-added under their address
+    for (int i = 0; i < MAX_SLAVES; i++) {
+        makeMac(i, mac);
+        TEST_ASSERT_EQUAL(i, registry.find(mac));
+    }
+    makeMac(MAX_SLAVES - 1, mac);
+    TEST_ASSERT_EQUAL(MAX_SLAVES - 1, registry.add(mac));
+}
+
+void test_fingerprint_follows_chain_order() {
+    uint8_t a[6];
+    uint8_t b[6];
+    makeMac(1, a);
+    makeMac(2, b);
+    const uint32_t empty = registry.fingerprint();
+    TEST_ASSERT_EQUAL_UINT32(SlaveRegistry::CHAIN_SEED, empty);
+
+    registry.add(a);
+    registry.add(b);
+    const uint32_t ab = registry.fingerprint();
+    TEST_ASSERT_EQUAL_UINT32(SlaveRegistry::chainHash(SlaveRegistry::chainHash(empty, a), b), ab);
+
+    registry.clear();
+    registry.add(b);
+    registry.add(a);
+    TEST_ASSERT_NOT_EQUAL(ab, registry.fingerprint());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_add_assigns_addresses_in_order);
+    RUN_TEST(test_colliding_macs_probe_past_each_other);
+    RUN_TEST(test_truncate_rebuilds_the_index);
+    RUN_TEST(test_add_rejects_when_full);
+    RUN_TEST(test_fingerprint_follows_chain_order);
+    return UNITY_END();
+}